@@ -1,65 +1,463 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "block.h"
 #include "../crypto/hash.h"
 
-// initialize a new block
-void init_block(Block *block, int index, const char *prev_hash)
+// initialize a new block with an empty transaction list
+void init_block(Block *block, int index, const Digest *prev_hash)
 {
+    block->version = BLOCK_VERSION_CURRENT;
     block->index = index;
     block->timestamp = time(NULL);
-    strcpy(block->previous_hash, prev_hash);
+    block->previous_hash = *prev_hash;
+    block->transactions = NULL;
     block->transaction_count = 0;
+    block->transaction_capacity = 0;
 
-    memset(block->block_hash, 0, HASH_SIZE);
+    memset(&block->block_hash, 0, sizeof(block->block_hash));
+    memset(&block->merkle_root, 0, sizeof(block->merkle_root));
     memset(block->validator_signature, 0, HASH_SIZE);
 }
 
+// make room for count transactions in total
+int reserve_transactions(Block *block, int count)
+{
+    if (count < 0 || count > MAX_TRANSACTIONS)
+        return 0;
+
+    if (count <= block->transaction_capacity)
+        return 1;
+
+    int capacity = block->transaction_capacity ? block->transaction_capacity : 4;
+    while (capacity < count)
+        capacity *= 2;
+
+    if (capacity > MAX_TRANSACTIONS)
+        capacity = MAX_TRANSACTIONS;
+
+    Transaction *transactions = realloc(block->transactions,
+                                        sizeof(Transaction) * capacity);
+    if (!transactions)
+        return 0;
+
+    block->transactions = transactions;
+    block->transaction_capacity = capacity;
+    return 1;
+}
+
 // add a transaction to the block
-int add_transaction(Block *block, Transaction tx)
+int add_transaction(Block *block, const Transaction *tx)
 {
-    if (block->transaction_count >= MAX_TRANSACTIONS)
+    if (!reserve_transactions(block, block->transaction_count + 1))
         return 0;
 
-    block->transactions[block->transaction_count++] = tx;
+    block->transactions[block->transaction_count++] = *tx;
     return 1;
 }
 
-// generate hash for the block
-void calculate_block_hash(Block *block)
+// release the transaction list; the block is left empty
+void free_block(Block *block)
+{
+    free(block->transactions);
+
+    block->transactions = NULL;
+    block->transaction_count = 0;
+    block->transaction_capacity = 0;
+}
+
+// deep copy; dst must not own a transaction list
+int copy_block(Block *dst, const Block *src)
+{
+    *dst = *src;
+
+    dst->transactions = NULL;
+    dst->transaction_count = 0;
+    dst->transaction_capacity = 0;
+
+    if (!reserve_transactions(dst, src->transaction_count))
+        return 0;
+
+    if (src->transaction_count > 0)
+        memcpy(dst->transactions, src->transactions,
+               sizeof(Transaction) * src->transaction_count);
+
+    dst->transaction_count = src->transaction_count;
+    return 1;
+}
+
+int block_version_supported(int version)
+{
+    return version == BLOCK_VERSION_LEGACY ||
+           version == BLOCK_VERSION_BINARY ||
+           version == BLOCK_VERSION_MERKLE;
+}
+
+// fields staged before each hash update when streaming
+#define PREIMAGE_STAGE_SIZE 256
+
+// preimage output: streamed into a hash context, or gathered for the lanes
+typedef struct {
+    Sha256Ctx *ctx;
+    unsigned char *buffer;
+    size_t capacity;
+    size_t len;
+    int overflow;
+    unsigned char stage[PREIMAGE_STAGE_SIZE];
+    size_t staged;
+} PreimageSink;
+
+static void sink_init(PreimageSink *sink, Sha256Ctx *ctx,
+                      unsigned char *buffer, size_t capacity)
+{
+    sink->ctx = ctx;
+    sink->buffer = buffer;
+    sink->capacity = capacity;
+    sink->len = 0;
+    sink->overflow = 0;
+    sink->staged = 0;
+}
+
+static void sink_flush(PreimageSink *sink)
+{
+    if (sink->ctx && sink->staged > 0)
+        sha256_update(sink->ctx, sink->stage, sink->staged);
+
+    sink->staged = 0;
+}
+
+static void sink_bytes(PreimageSink *sink, const void *data, size_t len)
+{
+    if (sink->ctx)
+    {
+        // small fields are batched so the context sees few, larger updates
+        if (sink->staged + len > PREIMAGE_STAGE_SIZE)
+            sink_flush(sink);
+
+        if (len > PREIMAGE_STAGE_SIZE)
+        {
+            sha256_update(sink->ctx, data, len);
+        }
+        else
+        {
+            memcpy(sink->stage + sink->staged, data, len);
+            sink->staged += len;
+        }
+
+        sink->len += len;
+        return;
+    }
+
+    if (sink->overflow || sink->len + len > sink->capacity)
+    {
+        sink->overflow = 1;
+        return;
+    }
+
+    memcpy(sink->buffer + sink->len, data, len);
+    sink->len += len;
+}
+
+static void sink_u32(PreimageSink *sink, uint32_t v)
+{
+    unsigned char b[4];
+    for (int i = 0; i < 4; i++)
+        b[i] = (v >> (8 * i)) & 0xff;
+    sink_bytes(sink, b, 4);
+}
+
+static void sink_u64(PreimageSink *sink, uint64_t v)
+{
+    unsigned char b[8];
+    for (int i = 0; i < 8; i++)
+        b[i] = (v >> (8 * i)) & 0xff;
+    sink_bytes(sink, b, 8);
+}
+
+// u32 length + bytes of a fixed-size text field
+static void sink_text(PreimageSink *sink, const char *text, size_t field_size)
+{
+    size_t len = strnlen(text, field_size);
+
+    sink_u32(sink, (uint32_t)len);
+    sink_bytes(sink, text, len);
+}
+
+// append one formatted piece; pieces were built in a 256-byte buffer
+static void sink_legacy(PreimageSink *sink, const char *temp, int n, size_t temp_size)
 {
-    char buffer[2048];
-    buffer[0] = '\0';
+    if (n < 0)
+        return;
 
+    if ((size_t)n >= temp_size)
+        n = (int)(temp_size - 1);
+
+    sink_bytes(sink, temp, (size_t)n);
+}
+
+// v1: decimal fields and hex digests, concatenated
+static void legacy_preimage(const Block *block, PreimageSink *sink)
+{
     char temp[256];
+    char hex[DIGEST_HEX_SIZE];
+    int n;
 
-    // block metadata
-    snprintf(temp, sizeof(temp),
-             "%d%ld%s%d",
-             block->index,
-             block->timestamp,
-             block->previous_hash,
-             block->transaction_count);
+    digest_to_hex(&block->previous_hash, hex);
 
-    strcat(buffer, temp);
+    n = snprintf(temp, sizeof(temp),
+                 "%d%ld%s%d",
+                 block->index,
+                 block->timestamp,
+                 hex,
+                 block->transaction_count);
+
+    sink_legacy(sink, temp, n, sizeof(temp));
 
-    // transaction data
     for (int i = 0; i < block->transaction_count; i++)
     {
-        snprintf(temp, sizeof(temp),
-                 "%s%s%s%s%ld",
-                 block->transactions[i].patient_id,
-                 block->transactions[i].doctor_id,
-                 block->transactions[i].data_hash,
-                 block->transactions[i].data_pointer,
-                 block->transactions[i].timestamp);
-
-        strcat(buffer, temp);
+        const Transaction *tx = &block->transactions[i];
+
+        digest_to_hex(&tx->data_hash, hex);
+
+        n = snprintf(temp, sizeof(temp),
+                     "%s%s%s%s%ld",
+                     tx->patient_id,
+                     tx->doctor_id,
+                     hex,
+                     tx->data_pointer,
+                     tx->timestamp);
+
+        sink_legacy(sink, temp, n, sizeof(temp));
     }
+}
 
-    sha256(buffer, block->block_hash);
+// transaction fields, shared by the v2 preimage and the v3 merkle leaves
+static void transaction_preimage(const Transaction *tx, PreimageSink *sink)
+{
+    sink_text(sink, tx->patient_id, sizeof(tx->patient_id));
+    sink_text(sink, tx->doctor_id, sizeof(tx->doctor_id));
+    sink_bytes(sink, tx->data_hash.bytes, DIGEST_SIZE);
+    sink_text(sink, tx->data_pointer, sizeof(tx->data_pointer));
+    sink_u64(sink, (uint64_t)tx->timestamp);
 }
 
+// v2 layout (little endian):
+//   u32 version, u32 index, i64 timestamp, 32 previous_hash, u32 tx_count,
+//   then per transaction: text patient_id, text doctor_id, 32 data_hash,
+//   text data_pointer, i64 timestamp
+// text: u32 length + bytes
+static void binary_preimage(const Block *block, PreimageSink *sink)
+{
+    sink_u32(sink, (uint32_t)block->version);
+    sink_u32(sink, (uint32_t)block->index);
+    sink_u64(sink, (uint64_t)block->timestamp);
+    sink_bytes(sink, block->previous_hash.bytes, DIGEST_SIZE);
+    sink_u32(sink, (uint32_t)block->transaction_count);
 
+    for (int i = 0; i < block->transaction_count; i++)
+        transaction_preimage(&block->transactions[i], sink);
+}
+
+// v3 layout: the v2 header followed by 32 merkle_root; transactions are
+// covered through the root, so the header alone fixes the block hash
+static void header_preimage(const Block *block, PreimageSink *sink)
+{
+    sink_u32(sink, (uint32_t)block->version);
+    sink_u32(sink, (uint32_t)block->index);
+    sink_u64(sink, (uint64_t)block->timestamp);
+    sink_bytes(sink, block->previous_hash.bytes, DIGEST_SIZE);
+    sink_u32(sink, (uint32_t)block->transaction_count);
+    sink_bytes(sink, block->merkle_root.bytes, DIGEST_SIZE);
+}
+
+// emit the fields covered by the block hash
+static void block_preimage(const Block *block, PreimageSink *sink)
+{
+    if (block->version == BLOCK_VERSION_LEGACY)
+        legacy_preimage(block, sink);
+    else if (block->version == BLOCK_VERSION_BINARY)
+        binary_preimage(block, sink);
+    else
+        header_preimage(block, sink);
+}
+
+// leaf preimage: 0x00 tag + transaction fields; always fits LEAF_PREIMAGE_SIZE
+#define LEAF_PREIMAGE_SIZE 256
+
+static void leaf_preimage(const Transaction *tx, PreimageSink *sink)
+{
+    unsigned char tag = MERKLE_LEAF_TAG;
+
+    sink_bytes(sink, &tag, 1);
+    transaction_preimage(tx, sink);
+}
+
+// leaf = sha256(0x00 || transaction fields)
+void transaction_leaf_hash(const Transaction *tx, Digest *leaf)
+{
+    Sha256Ctx ctx;
+    PreimageSink sink;
+
+    sha256_init(&ctx);
+    sink_init(&sink, &ctx, NULL, 0);
+    leaf_preimage(tx, &sink);
+    sink_flush(&sink);
+    sha256_final(&ctx, leaf->bytes);
+}
+
+// leaf hashes of every transaction, computed on the lanes; caller frees
+static Digest *block_leaves(const Block *block)
+{
+    unsigned char preimages[SHA256_MAX_LANES][LEAF_PREIMAGE_SIZE];
+    const void *data[SHA256_MAX_LANES];
+    size_t lens[SHA256_MAX_LANES];
+    unsigned char digests[SHA256_MAX_LANES][DIGEST_SIZE];
+    int count = block->transaction_count;
+
+    if (count < 0 || count > MAX_TRANSACTIONS)
+        return NULL;
+
+    Digest *leaves = malloc(sizeof(Digest) * (count > 0 ? count : 1));
+    if (!leaves)
+        return NULL;
+
+    for (int base = 0; base < count; base += SHA256_MAX_LANES)
+    {
+        int n = count - base;
+        if (n > SHA256_MAX_LANES)
+            n = SHA256_MAX_LANES;
+
+        for (int i = 0; i < n; i++)
+        {
+            PreimageSink sink;
+
+            sink_init(&sink, NULL, preimages[i], LEAF_PREIMAGE_SIZE);
+            leaf_preimage(&block->transactions[base + i], &sink);
+
+            data[i] = preimages[i];
+            lens[i] = sink.len;
+        }
+
+        sha256_digest_many(data, lens, n, digests);
+
+        for (int i = 0; i < n; i++)
+            memcpy(leaves[base + i].bytes, digests[i], DIGEST_SIZE);
+    }
+
+    return leaves;
+}
+
+// root over the block's transactions
+int block_merkle_root(const Block *block, Digest *root)
+{
+    Digest *leaves = block_leaves(block);
+    if (!leaves)
+        return 0;
+
+    int ok = merkle_root(leaves, block->transaction_count, root);
+
+    free(leaves);
+    return ok;
+}
+
+// stored root must match the transactions; older versions have none
+int block_merkle_valid(const Block *block)
+{
+    Digest root;
+
+    if (block->version < BLOCK_VERSION_MERKLE)
+        return 1;
+
+    return block_merkle_root(block, &root) &&
+           digest_equal(&root, &block->merkle_root);
+}
+
+// inclusion proof of one transaction against the block's root
+int block_merkle_proof(const Block *block, int tx_index, MerkleProof *proof)
+{
+    Digest *leaves = block_leaves(block);
+    if (!leaves)
+        return 0;
+
+    int ok = merkle_proof(leaves, block->transaction_count, tx_index, proof);
+
+    free(leaves);
+    return ok;
+}
+
+// stream the preimage straight into one hash context
+static void hash_block_streamed(const Block *block, unsigned char digest[DIGEST_SIZE])
+{
+    Sha256Ctx ctx;
+    PreimageSink sink;
+
+    sha256_init(&ctx);
+    sink_init(&sink, &ctx, NULL, 0);
+    block_preimage(block, &sink);
+    sink_flush(&sink);
+    sha256_final(&ctx, digest);
+}
+
+// generate hash for the block, filling in its merkle root first
+void calculate_block_hash(Block *block)
+{
+    if (block->version >= BLOCK_VERSION_MERKLE &&
+        !block_merkle_root(block, &block->merkle_root))
+        memset(&block->merkle_root, 0, sizeof(block->merkle_root));
+
+    hash_block_streamed(block, block->block_hash.bytes);
+}
+
+// recompute the hash from the stored fields; v3 needs only the header
+void compute_block_hash(const Block *block, Digest *hash)
+{
+    hash_block_streamed(block, hash->bytes);
+}
+
+// hash a run of blocks together on the multi-lane backend
+void calculate_block_hashes(const Block *blocks, int count, Digest *hashes)
+{
+    unsigned char preimages[SHA256_MAX_LANES][BLOCK_PREIMAGE_SIZE];
+    const void *data[SHA256_MAX_LANES];
+    size_t lens[SHA256_MAX_LANES];
+    unsigned char digests[SHA256_MAX_LANES][DIGEST_SIZE];
+    int slots[SHA256_MAX_LANES];
+
+    for (int base = 0; base < count; base += SHA256_MAX_LANES)
+    {
+        int n = count - base;
+        if (n > SHA256_MAX_LANES)
+            n = SHA256_MAX_LANES;
+
+        int lanes = 0;
+
+        for (int i = 0; i < n; i++)
+        {
+            const Block *block = &blocks[base + i];
+            PreimageSink sink;
+
+            sink_init(&sink, NULL, preimages[lanes], BLOCK_PREIMAGE_SIZE);
+            block_preimage(block, &sink);
+
+            // oversized blocks are streamed on their own
+            if (sink.overflow)
+            {
+                hash_block_streamed(block, hashes[base + i].bytes);
+                continue;
+            }
+
+            slots[lanes] = base + i;
+            lens[lanes] = sink.len;
+            data[lanes] = preimages[lanes];
+            lanes++;
+        }
+
+        sha256_digest_many(data, lens, lanes, digests);
+
+        for (int i = 0; i < lanes; i++)
+            memcpy(hashes[slots[i]].bytes, digests[i], DIGEST_SIZE);
+    }
+}
@@ -3,31 +3,58 @@
 
 #include <time.h>
 
+#include "../crypto/hash.h"
+#include "merkle.h"
+
 #define HASH_SIZE 513
-#define MAX_TRANSACTIONS 5
+// hard cap per block; bounds what a decoder will allocate
+#define MAX_TRANSACTIONS 4096
+
+// block versions select how the block hash preimage is built
+#define BLOCK_VERSION_LEGACY 1      // decimal and hex text, as hashed by older nodes
+#define BLOCK_VERSION_BINARY 2      // canonical length-prefixed binary
+#define BLOCK_VERSION_MERKLE 3      // binary header committing to a merkle root
+#define BLOCK_VERSION_CURRENT BLOCK_VERSION_MERKLE
+
+// lane buffer for one block preimage; larger blocks are streamed
+#define BLOCK_PREIMAGE_SIZE 2048
 
 typedef struct {
     char patient_id[32];        // privacy first
     char doctor_id[32];
-    char data_hash[HASH_SIZE];  // hash for validation
+    Digest data_hash;           // hash for validation
     char data_pointer[128];     // location of the record
     time_t timestamp;
 } Transaction;
 
 typedef struct {
+    int version;
     int index;
     time_t timestamp;
-    char previous_hash[HASH_SIZE];
-    char block_hash[HASH_SIZE];
+    Digest previous_hash;
+    Digest block_hash;
+    Digest merkle_root;         // v3: root over the transactions
     char validator_signature[HASH_SIZE];
     int validator_port;
-    Transaction transactions[MAX_TRANSACTIONS];
+    Transaction *transactions;  // owned list, released by free_block
     int transaction_count;
+    int transaction_capacity;
 } Block;
 
-void init_block(Block *block, int index, const char *prev_hash);
-int add_transaction(Block *block, Transaction tx);
+void init_block(Block *block, int index, const Digest *prev_hash);
+int reserve_transactions(Block *block, int count);
+int add_transaction(Block *block, const Transaction *tx);
+void free_block(Block *block);
+int copy_block(Block *dst, const Block *src);
+int block_version_supported(int version);
 void calculate_block_hash(Block *block);
+void compute_block_hash(const Block *block, Digest *hash);
+void calculate_block_hashes(const Block *blocks, int count, Digest *hashes);
+
+void transaction_leaf_hash(const Transaction *tx, Digest *leaf);
+int block_merkle_root(const Block *block, Digest *root);
+int block_merkle_valid(const Block *block);
+int block_merkle_proof(const Block *block, int tx_index, MerkleProof *proof);
 
 
 #endif
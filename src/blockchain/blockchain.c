@@ -3,20 +3,522 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "blockchain.h"
+#include "digest_set.h"
+#include "storage.h"
+#include "chain_view.h"
+#include "verifier.h"
 #include "../crypto/hash.h"
 #include "../crypto/signature.h"
 
 static char blockchain_file[128] = "data/blockchain.dat";
+static char index_file[160] = "data/blockchain.idx";
+static char tx_index_file[160] = "data/blockchain.txi";
+static char checkpoint_file[160] = "data/blockchain.vck";
+static char quorum_file[160] = "data/blockchain.qcs";
 
 // mutex for thread safety
 static pthread_mutex_t blockchain_lock = PTHREAD_MUTEX_INITIALIZER;
 
+// on-disk index entry, one per stored block in append order
+typedef struct {
+    int64_t offset;
+    int32_t index;
+    int32_t length;
+} BlockIndexEntry;
+
+// block offset index state
+static int chain_fd = -1;
+static int index_fd = -1;
+static off_t chain_size = 0;
+
+// read-only mapping of chain_fd shared by every reader
+static ChainView chain_view;
+static int chain_view_ready = 0;
+
+static BlockIndexEntry *index_entries = NULL;
+static int index_count = 0;
+static int index_capacity = 0;
+
+// block index -> position in index_entries (-1 if absent)
+static int *index_lookup = NULL;
+static int lookup_capacity = 0;
+
+// block index -> offset of its newest .qcs record (-1 if absent), built
+// by one scan of the sidecar and extended as certificates are appended
+static off_t *qc_offsets = NULL;
+static int qc_offset_capacity = 0;
+static off_t qc_scanned = 0;
+
+// transaction hash set for duplicate detection
+static DigestSet tx_index;
+static int tx_index_open = 0;
+
+// blocks folded into tx_index; the header watermark trails it and only
+// moves after a sync, so a crash replays from the last durable point
+#define TX_INDEX_SYNC_INTERVAL 1024
+static int tx_indexed_blocks = 0;
+
+// durable verification watermark
+#define CHECKPOINT_MAGIC "MRVCHK02"
+
+typedef struct {
+    char magic[8];
+    int64_t verified_height;
+    Digest tip_hash;
+} VerifyCheckpoint;
+
+static VerifyCheckpoint checkpoint;
+static int checkpoint_loaded = 0;
+
+// chain tip cache, readable without blockchain_lock
+static pthread_rwlock_t tip_lock = PTHREAD_RWLOCK_INITIALIZER;
+static Block chain_tip;
+static int chain_height = 0;
+static int tip_loaded = 0;
+
+// publish a new tip for lock-free readers; the cache keeps its own copy
+static void publish_chain_tip(const Block *tip, int height)
+{
+    pthread_rwlock_wrlock(&tip_lock);
+
+    if (tip)
+    {
+        free_block(&chain_tip);
+
+        if (!copy_block(&chain_tip, tip))
+            printf("[BLOCKCHAIN] Failed to cache transactions of the chain tip.\n");
+    }
+
+    chain_height = height;
+    tip_loaded = 1;
+
+    pthread_rwlock_unlock(&tip_lock);
+}
+
+// derive a sidecar path from the chain path
+static void build_sidecar_path(char *out, size_t out_size,
+                               const char *filename, const char *ext)
+{
+    size_t len = strlen(filename);
+
+    if (len > 4 && strcmp(filename + len - 4, ".dat") == 0)
+        snprintf(out, out_size, "%.*s%s", (int)(len - 4), filename, ext);
+    else
+        snprintf(out, out_size, "%s%s", filename, ext);
+}
+
+// make the folded-in digests durable, then let the watermark cover them
+static void persist_tx_watermark()
+{
+    if (tx_indexed_blocks == (int)tx_index.header->indexed_blocks)
+        return;
+
+    if (!digest_set_sync(&tx_index))
+    {
+        printf("[STORAGE] Failed to sync transaction index.\n");
+        return;
+    }
+
+    tx_index.header->indexed_blocks = tx_indexed_blocks;
+}
+
+// drop the in-memory index and close descriptors
+static void reset_block_index_locked()
+{
+    if (chain_view_ready)
+        chain_view_close(&chain_view);
+    chain_view_ready = 0;
+
+    if (chain_fd >= 0)
+        close(chain_fd);
+    if (index_fd >= 0)
+        close(index_fd);
+
+    chain_fd = -1;
+    index_fd = -1;
+    chain_size = 0;
+
+    if (tx_index_open)
+    {
+        persist_tx_watermark();
+        digest_set_close(&tx_index);
+    }
+    tx_index_open = 0;
+
+    checkpoint_loaded = 0;
+
+    free(index_entries);
+    free(index_lookup);
+
+    index_entries = NULL;
+    index_count = 0;
+    index_capacity = 0;
+    index_lookup = NULL;
+    lookup_capacity = 0;
+
+    free(qc_offsets);
+    qc_offsets = NULL;
+    qc_offset_capacity = 0;
+    qc_scanned = 0;
+
+    pthread_rwlock_wrlock(&tip_lock);
+    chain_height = 0;
+    tip_loaded = 0;
+    pthread_rwlock_unlock(&tip_lock);
+}
+
 // set the blockchain file path
 void set_blockchain_file(const char *filename)
 {
-    strncpy(blockchain_file, filename, sizeof(blockchain_file));
+    pthread_mutex_lock(&blockchain_lock);
+
+    reset_block_index_locked();
+
+    snprintf(blockchain_file, sizeof(blockchain_file), "%s", filename);
+    build_sidecar_path(index_file, sizeof(index_file), blockchain_file, ".idx");
+    build_sidecar_path(tx_index_file, sizeof(tx_index_file), blockchain_file, ".txi");
+    build_sidecar_path(checkpoint_file, sizeof(checkpoint_file), blockchain_file, ".vck");
+    build_sidecar_path(quorum_file, sizeof(quorum_file), blockchain_file, ".qcs");
+
+    pthread_mutex_unlock(&blockchain_lock);
+}
+
+// read one stored block at a file offset
+static int read_block_at(off_t offset, Block *block, size_t *record_len)
+{
+    BlockRecordRef ref;
+
+    if (offset >= chain_size ||
+        !chain_view_at(&chain_view, offset, &ref) ||
+        ref.offset + (off_t)ref.len > chain_size)
+        return 0;
+
+    return decode_block_record(ref.data, ref.len, block, record_len);
+}
+
+// record a block position in the memory tables
+static int track_block_offset(int block_index, off_t offset, size_t length)
+{
+    if (index_count == index_capacity)
+    {
+        int new_capacity = index_capacity ? index_capacity * 2 : 256;
+        BlockIndexEntry *entries = realloc(index_entries,
+                                           new_capacity * sizeof(BlockIndexEntry));
+        if (!entries)
+            return 0;
+
+        index_entries = entries;
+        index_capacity = new_capacity;
+    }
+
+    if (block_index >= 0 && block_index >= lookup_capacity)
+    {
+        int new_capacity = lookup_capacity ? lookup_capacity : 256;
+        while (new_capacity <= block_index)
+            new_capacity *= 2;
+
+        int *lookup = realloc(index_lookup, new_capacity * sizeof(int));
+        if (!lookup)
+            return 0;
+
+        for (int i = lookup_capacity; i < new_capacity; i++)
+            lookup[i] = -1;
+
+        index_lookup = lookup;
+        lookup_capacity = new_capacity;
+    }
+
+    BlockIndexEntry *entry = &index_entries[index_count];
+    entry->offset = offset;
+    entry->index = block_index;
+    entry->length = (int32_t)length;
+
+    // first stored copy wins, like the old linear scan
+    if (block_index >= 0 && index_lookup[block_index] == -1)
+        index_lookup[block_index] = index_count;
+
+    index_count++;
+    return 1;
+}
+
+// fold a block's transactions into the duplicate index, each mapped to the
+// index of the block that holds it
+static void index_block_transactions(const Block *block)
+{
+    for (int i = 0; i < block->transaction_count; i++)
+    {
+        if (digest_set_insert(&tx_index, block->transactions[i].data_hash.bytes,
+                              (uint32_t)block->index) < 0)
+            printf("[STORAGE] Failed to update transaction index.\n");
+    }
+
+    tx_indexed_blocks++;
+
+    if (tx_indexed_blocks - (int)tx_index.header->indexed_blocks >= TX_INDEX_SYNC_INTERVAL)
+        persist_tx_watermark();
+}
+
+// open the transaction index and catch it up with the chain
+static int load_tx_index_locked()
+{
+    if (!digest_set_open(&tx_index, tx_index_file, 0))
+    {
+        printf("[STORAGE] Failed to open transaction index %s.\n", tx_index_file);
+        return 0;
+    }
+
+    tx_index_open = 1;
+
+    // a chain shorter than the index means it was rewritten
+    if (tx_index.header->indexed_blocks > (uint64_t)index_count)
+        digest_set_clear(&tx_index);
+
+    int start = (int)tx_index.header->indexed_blocks;
+    tx_indexed_blocks = start;
+
+    for (int i = start; i < index_count; i++)
+    {
+        Block temp;
+
+        if (!read_block_at(index_entries[i].offset, &temp, NULL))
+            return 0;
+
+        index_block_transactions(&temp);
+        free_block(&temp);
+    }
+
+    if (index_count > start)
+    {
+        persist_tx_watermark();
+        printf("[STORAGE] Indexed transactions of %d block(s).\n",
+               index_count - start);
+    }
+
+    return 1;
+}
+
+// open the chain and rebuild the offset index from the sidecar
+static int load_block_index_locked()
+{
+    if (chain_fd >= 0)
+        return 1;
+
+    chain_fd = open(blockchain_file, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (chain_fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(chain_fd, &st) != 0)
+    {
+        reset_block_index_locked();
+        return 0;
+    }
+
+    chain_size = st.st_size;
+
+    unsigned char header[CHAIN_HEADER_SIZE];
+
+    if (chain_size == 0)
+    {
+        write_chain_header(header);
+
+        if (write(chain_fd, header, sizeof(header)) != (ssize_t)sizeof(header))
+        {
+            reset_block_index_locked();
+            return 0;
+        }
+
+        chain_size = sizeof(header);
+    }
+    else if (pread(chain_fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+             !check_chain_header(header, sizeof(header)))
+    {
+        printf("[STORAGE] %s is not in the current chain format. Run migrate_chain.\n",
+               blockchain_file);
+        reset_block_index_locked();
+        return 0;
+    }
+
+    if (!chain_view_attach(&chain_view, chain_fd))
+    {
+        printf("[STORAGE] Failed to map %s.\n", blockchain_file);
+        reset_block_index_locked();
+        return 0;
+    }
+
+    chain_view_ready = 1;
+
+    index_fd = open(index_file, O_RDWR | O_CREAT, 0644);
+    if (index_fd < 0)
+    {
+        printf("[STORAGE] Failed to open block index %s.\n", index_file);
+        reset_block_index_locked();
+        return 0;
+    }
+
+    // trust sidecar entries only while they chain end to end
+    off_t expected = CHAIN_HEADER_SIZE;
+    BlockIndexEntry entry;
+
+    while (pread(index_fd, &entry, sizeof(entry),
+                 (off_t)index_count * sizeof(entry)) == (ssize_t)sizeof(entry))
+    {
+        if (entry.offset != expected || entry.length <= 0 ||
+            entry.offset + entry.length > chain_size)
+            break;
+
+        if (!track_block_offset(entry.index, entry.offset, entry.length))
+        {
+            reset_block_index_locked();
+            return 0;
+        }
+
+        expected = entry.offset + entry.length;
+    }
+
+    // confirm the sidecar against the chain with a single tail read
+    Block tail;
+    int have_tail = 0;
+    size_t record_len;
+
+    if (index_count > 0)
+    {
+        BlockIndexEntry *last = &index_entries[index_count - 1];
+
+        have_tail = read_block_at(last->offset, &tail, &record_len);
+
+        if (have_tail &&
+            (tail.index != last->index || (int32_t)record_len != last->length))
+        {
+            free_block(&tail);
+            have_tail = 0;
+        }
+
+        if (!have_tail)
+        {
+            printf("[STORAGE] Block index out of date. Rebuilding.\n");
+
+            for (int i = 0; i < lookup_capacity; i++)
+                index_lookup[i] = -1;
+
+            index_count = 0;
+            expected = CHAIN_HEADER_SIZE;
+        }
+    }
+
+    int indexed = index_count;
+
+    // recover blocks appended after the sidecar was last written
+    Block temp;
+
+    while (read_block_at(expected, &temp, &record_len))
+    {
+        if (!track_block_offset(temp.index, expected, record_len))
+        {
+            free_block(&temp);
+            if (have_tail)
+                free_block(&tail);
+            reset_block_index_locked();
+            return 0;
+        }
+
+        // the newest record read becomes the tail
+        if (have_tail)
+            free_block(&tail);
+
+        tail = temp;
+        have_tail = 1;
+        expected += record_len;
+    }
+
+    // a record that is all there but does not decode is corruption, not a
+    // torn append; refuse to open rather than cut off the blocks behind it
+    if (expected < chain_size && chain_size - expected >= 4)
+    {
+        unsigned char prefix[4];
+        uint32_t body = 0;
+
+        if (pread(chain_fd, prefix, sizeof(prefix), expected) == (ssize_t)sizeof(prefix))
+            body = (uint32_t)prefix[0] | (uint32_t)prefix[1] << 8 |
+                   (uint32_t)prefix[2] << 16 | (uint32_t)prefix[3] << 24;
+
+        if (4 + (off_t)body <= chain_size - expected)
+        {
+            printf("[STORAGE] Corrupt block record at offset %ld of %s. Refusing to open.\n",
+                   (long)expected, blockchain_file);
+
+            if (have_tail)
+                free_block(&tail);
+            reset_block_index_locked();
+            return 0;
+        }
+    }
+
+    // discard a torn trailing record so appends stay aligned
+    if (expected < chain_size)
+    {
+        printf("[STORAGE] Truncating %ld trailing bytes of partial block.\n",
+               (long)(chain_size - expected));
+
+        if (ftruncate(chain_fd, expected) == 0)
+            chain_size = expected;
+
+        chain_view_remap(&chain_view);
+    }
+
+    // rewrite the sidecar tail if it was stale
+    if (ftruncate(index_fd, (off_t)indexed * sizeof(BlockIndexEntry)) != 0)
+        printf("[STORAGE] Failed to trim block index.\n");
+
+    if (index_count > indexed)
+    {
+        size_t bytes = (size_t)(index_count - indexed) * sizeof(BlockIndexEntry);
+
+        if (pwrite(index_fd, &index_entries[indexed], bytes,
+                   (off_t)indexed * sizeof(BlockIndexEntry)) != (ssize_t)bytes)
+            printf("[STORAGE] Failed to update block index.\n");
+        else
+            printf("[STORAGE] Recovered %d unindexed block(s).\n",
+                   index_count - indexed);
+    }
+
+    if (!load_tx_index_locked())
+    {
+        if (have_tail)
+            free_block(&tail);
+        reset_block_index_locked();
+        return 0;
+    }
+
+    publish_chain_tip(have_tail ? &tail : NULL, index_count);
+
+    if (have_tail)
+        free_block(&tail);
+
+    return 1;
+}
+
+// make sure the tip cache is seeded
+static int ensure_chain_loaded()
+{
+    pthread_rwlock_rdlock(&tip_lock);
+    int loaded = tip_loaded;
+    pthread_rwlock_unlock(&tip_lock);
+
+    if (loaded)
+        return 1;
+
+    pthread_mutex_lock(&blockchain_lock);
+    int ok = load_block_index_locked();
+    pthread_mutex_unlock(&blockchain_lock);
+
+    return ok;
 }
 
 // create the first block (genesis)
@@ -24,28 +526,35 @@ void create_genesis_block(Block *block, int validator_port)
 {
     memset(block, 0, sizeof(Block));
 
+    // genesis keeps the legacy preimage so every node derives the same hash
+    block->version = BLOCK_VERSION_LEGACY;
     block->index = 0;
     block->timestamp = 1737280140;
     block->validator_port = validator_port;
 
-    strcpy(block->previous_hash, "0");
+    // the zero digest is the genesis parent "0"
+    memset(&block->previous_hash, 0, sizeof(block->previous_hash));
 
-    block->transaction_count = 1;
+    Transaction tx;
+    memset(&tx, 0, sizeof(tx));
 
-    strcpy(block->transactions[0].patient_id, "GENESIS");
-    strcpy(block->transactions[0].doctor_id, "NETWORK");
+    strcpy(tx.patient_id, "GENESIS");
+    strcpy(tx.doctor_id, "NETWORK");
 
     const char *genesis_message =
         "The Fall of the star to the brink of an end from the loving pool";
 
-    sha256(genesis_message,
-           block->transactions[0].data_hash);
+    sha256_digest(genesis_message, strlen(genesis_message), tx.data_hash.bytes);
+
+    strncpy(tx.data_pointer, genesis_message, sizeof(tx.data_pointer) - 1);
 
-    strncpy(block->transactions[0].data_pointer,
-            genesis_message,
-            sizeof(block->transactions[0].data_pointer) - 1);
+    tx.timestamp = 1737280140;
 
-    block->transactions[0].timestamp = 1737280140;
+    if (!add_transaction(block, &tx))
+    {
+        printf("[BLOCKCHAIN] Genesis allocation failed.\n");
+        exit(1);
+    }
 
     calculate_block_hash(block);
 
@@ -53,7 +562,10 @@ void create_genesis_block(Block *block, int validator_port)
     snprintf(private_key_path, sizeof(private_key_path),
              "keys/%d_private.pem", validator_port);
 
-    if (!sign_data(block->block_hash,
+    char hash_hex[DIGEST_HEX_SIZE];
+    digest_to_hex(&block->block_hash, hash_hex);
+
+    if (!sign_data(hash_hex,
                    private_key_path,
                    block->validator_signature))
     {
@@ -65,217 +577,456 @@ void create_genesis_block(Block *block, int validator_port)
            validator_port);
 }
 
-// append a block securely
-void add_block(Block *new_block)
+// the hash must cover the header, the merkle root the transactions, and
+// the proposer must have signed the hash
+int block_authentic(const Block *block)
+{
+    Digest computed;
+    compute_block_hash(block, &computed);
+
+    if (!digest_equal(&computed, &block->block_hash) ||
+        !block_merkle_valid(block))
+        return 0;
+
+    char hash_hex[DIGEST_HEX_SIZE];
+    char key_path[64];
+
+    digest_to_hex(&block->block_hash, hash_hex);
+    snprintf(key_path, sizeof(key_path),
+             "keys/%d_public.pem", block->validator_port);
+
+    return verify_signature(hash_hex, key_path, block->validator_signature);
+}
+
+// append a block securely; 0 when it is not stored. Committers racing for
+// the same height are settled here, under the lock that appends
+int add_block(Block *new_block)
 {
     pthread_mutex_lock(&blockchain_lock);
 
-    FILE *fp = fopen(blockchain_file, "ab");
-    if (!fp)
+    if (!load_block_index_locked())
     {
         pthread_mutex_unlock(&blockchain_lock);
         printf("[STORAGE] Failed to open blockchain file.\n");
-        return;
+        return 0;
     }
 
-    fwrite(new_block, sizeof(Block), 1, fp);
-    fflush(fp);
-    fclose(fp);
+    // the block must extend the current tip
+    if (new_block->index != index_count ||
+        (index_count > 0 &&
+         !digest_equal(&new_block->previous_hash, &chain_tip.block_hash)))
+    {
+        int height = index_count;
+        pthread_mutex_unlock(&blockchain_lock);
+        printf("[CHAIN] Block %d does not extend the tip at height %d, not stored.\n",
+               new_block->index, height);
+        return 0;
+    }
 
-    pthread_mutex_unlock(&blockchain_lock);
-}
+    size_t capacity = block_record_bound(new_block);
+    unsigned char *record = malloc(capacity);
+    size_t record_len = record ? encode_block_record(new_block, record, capacity) : 0;
 
-// retrieve the last block locally
-int get_last_block(Block *last_block)
-{
-    pthread_mutex_lock(&blockchain_lock);
+    if (record_len == 0)
+    {
+        free(record);
+        pthread_mutex_unlock(&blockchain_lock);
+        printf("[STORAGE] Block %d could not be encoded.\n", new_block->index);
+        return 0;
+    }
 
-    FILE *fp = fopen(blockchain_file, "rb");
-    if (!fp)
+    off_t offset = chain_size;
+    ssize_t written = write(chain_fd, record, record_len);
+
+    free(record);
+
+    if (written != (ssize_t)record_len)
     {
+        // roll back a short write so the next append stays aligned
+        if (ftruncate(chain_fd, offset) != 0)
+            printf("[STORAGE] Failed to roll back partial block.\n");
+
         pthread_mutex_unlock(&blockchain_lock);
+        printf("[STORAGE] Failed to write block %d.\n", new_block->index);
         return 0;
     }
 
-    Block temp;
-    int found = 0;
+    chain_size = offset + record_len;
 
-    while (fread(&temp, sizeof(Block), 1, fp) == 1)
+    // sidecar is written after the block; recovery covers a crash in between
+    if (track_block_offset(new_block->index, offset, record_len))
     {
-        *last_block = temp;
-        found = 1;
+        BlockIndexEntry *entry = &index_entries[index_count - 1];
+
+        if (pwrite(index_fd, entry, sizeof(*entry),
+                   (off_t)(index_count - 1) * sizeof(*entry)) != (ssize_t)sizeof(*entry))
+            printf("[STORAGE] Failed to update block index.\n");
     }
 
-    fclose(fp);
+    index_block_transactions(new_block);
+
+    publish_chain_tip(new_block, index_count);
+
     pthread_mutex_unlock(&blockchain_lock);
 
+    return 1;
+}
+
+// retrieve the last block locally; the caller frees the copy
+int get_last_block(Block *last_block)
+{
+    if (!ensure_chain_loaded())
+        return 0;
+
+    pthread_rwlock_rdlock(&tip_lock);
+
+    int found = chain_height > 0 && copy_block(last_block, &chain_tip);
+
+    pthread_rwlock_unlock(&tip_lock);
+
     return found;
 }
 
 // get latest block hash
-int get_last_block_hash(char *output_hash)
+int get_last_block_hash(Digest *output_hash)
 {
-    Block last_block;
-
-    if (!get_last_block(&last_block))
+    if (!ensure_chain_loaded())
         return 0;
 
-    strcpy(output_hash, last_block.block_hash);
-    return 1;
+    pthread_rwlock_rdlock(&tip_lock);
+
+    int found = chain_height > 0;
+    if (found)
+        *output_hash = chain_tip.block_hash;
+
+    pthread_rwlock_unlock(&tip_lock);
+
+    return found;
 }
 
-// validate the entire chain
-int verify_blockchain()
+// load the verification watermark, if any
+static void load_checkpoint_locked()
 {
-    pthread_mutex_lock(&blockchain_lock);
+    if (checkpoint_loaded)
+        return;
 
-    FILE *fp = fopen(blockchain_file, "rb");
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    checkpoint_loaded = 1;
+
+    FILE *fp = fopen(checkpoint_file, "rb");
     if (!fp)
-    {
-        pthread_mutex_unlock(&blockchain_lock);
-        return 0;
-    }
+        return;
 
-    Block prev, curr;
+    VerifyCheckpoint temp;
 
-    if (fread(&prev, sizeof(Block), 1, fp) != 1)
-    {
-        fclose(fp);
-        pthread_mutex_unlock(&blockchain_lock);
-        return 0;
-    }
+    if (fread(&temp, sizeof(temp), 1, fp) == 1 &&
+        memcmp(temp.magic, CHECKPOINT_MAGIC, sizeof(temp.magic)) == 0)
+        checkpoint = temp;
+
+    fclose(fp);
+}
+
+// persist the watermark with write, fsync and rename; NULL clears the tip
+static void save_checkpoint_locked(int height, const Digest *tip_hash)
+{
+    VerifyCheckpoint temp;
+    memset(&temp, 0, sizeof(temp));
+
+    memcpy(temp.magic, CHECKPOINT_MAGIC, sizeof(temp.magic));
+    temp.verified_height = height;
+    if (tip_hash)
+        temp.tip_hash = *tip_hash;
 
-    char stored_hash[HASH_SIZE];
-    strcpy(stored_hash, prev.block_hash);
+    char tmp_path[sizeof(checkpoint_file) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", checkpoint_file);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
 
-    calculate_block_hash(&prev);
+    int ok = write(fd, &temp, sizeof(temp)) == (ssize_t)sizeof(temp) &&
+             fsync(fd) == 0;
+    close(fd);
 
-    if (strcmp(stored_hash, prev.block_hash) != 0)
+    if (!ok || rename(tmp_path, checkpoint_file) != 0)
     {
-        printf("[BLOCKCHAIN] Genesis hash validation failed.\n");
-        fclose(fp);
-        pthread_mutex_unlock(&blockchain_lock);
-        return 0;
+        printf("[STORAGE] Failed to save verification checkpoint.\n");
+        unlink(tmp_path);
+        return;
     }
 
-    char public_key_path[64];
-    snprintf(public_key_path, sizeof(public_key_path),
-             "keys/%d_public.pem", prev.validator_port);
+    checkpoint = temp;
+    checkpoint_loaded = 1;
+}
 
-    if (!verify_signature(stored_hash,
-                          public_key_path,
-                          prev.validator_signature))
-    {
-        printf("[CRYPTO] Genesis signature validation failed.\n");
-        fclose(fp);
-        pthread_mutex_unlock(&blockchain_lock);
+// blocks re-hashed and signature-checked per batch
+#define VERIFY_WINDOW 256
+
+// a window is closed early once it holds this many transactions
+#define VERIFY_WINDOW_TRANSACTIONS 65536
+
+// per-window scratch space for batched verification
+typedef struct {
+    Block blocks[VERIFY_WINDOW];
+    Digest hashes[VERIFY_WINDOW];
+    char hash_hex[VERIFY_WINDOW][DIGEST_HEX_SIZE];   // signed form of each block hash
+    char public_key_paths[VERIFY_WINDOW][64];
+    SignatureCheck checks[VERIFY_WINDOW];
+    unsigned char results[SIGNATURE_BITMAP_SIZE(VERIFY_WINDOW)];
+} VerifyWindow;
+
+// links are checked in order; hashes and signatures go out in batches
+static int verify_range_locked(int start, Digest *prev_hash)
+{
+    VerifyWindow *vw = malloc(sizeof(VerifyWindow));
+    if (!vw)
         return 0;
-    }
 
-    strcpy(stored_hash, prev.block_hash);
+    int valid = 1;
+
+    int window = start;
 
-    while (fread(&curr, sizeof(Block), 1, fp) == 1)
+    while (window < index_count && valid)
     {
-        if (strcmp(curr.previous_hash, stored_hash) != 0)
+        int end = window + VERIFY_WINDOW;
+        if (end > index_count)
+            end = index_count;
+
+        int n = 0;
+        int transactions = 0;
+        char failure[96] = "";
+
+        // read the window and check links against the stored hashes
+        for (int i = window; i < end && transactions < VERIFY_WINDOW_TRANSACTIONS; i++)
         {
-            printf("[BLOCKCHAIN] Previous hash mismatch at block %d.\n",
-                   curr.index);
-            fclose(fp);
-            pthread_mutex_unlock(&blockchain_lock);
-            return 0;
+            Block *curr = &vw->blocks[n];
+
+            if (!read_block_at(index_entries[i].offset, curr, NULL))
+            {
+                snprintf(failure, sizeof(failure),
+                         "[STORAGE] Failed to read stored block %d.\n", i);
+                break;
+            }
+
+            if (i > 0 && !digest_equal(&curr->previous_hash, prev_hash))
+            {
+                snprintf(failure, sizeof(failure),
+                         "[BLOCKCHAIN] Previous hash mismatch at block %d.\n",
+                         curr->index);
+                free_block(curr);
+                break;
+            }
+
+            *prev_hash = curr->block_hash;
+            transactions += curr->transaction_count;
+            n++;
         }
 
-        char original_hash[HASH_SIZE];
-        strcpy(original_hash, curr.block_hash);
+        calculate_block_hashes(vw->blocks, n, vw->hashes);
 
-        calculate_block_hash(&curr);
+        int hash_failure = -1;
 
-        if (strcmp(original_hash, curr.block_hash) != 0)
+        for (int k = 0; k < n; k++)
         {
-            printf("[BLOCKCHAIN] Hash validation failed at block %d.\n",
-                   curr.index);
-            fclose(fp);
-            pthread_mutex_unlock(&blockchain_lock);
-            return 0;
+            if (!digest_equal(&vw->hashes[k], &vw->blocks[k].block_hash) ||
+                !block_merkle_valid(&vw->blocks[k]))
+            {
+                hash_failure = k;
+                break;
+            }
         }
 
-        snprintf(public_key_path, sizeof(public_key_path),
-                 "keys/%d_public.pem", curr.validator_port);
+        // only blocks before the first bad hash need their signatures checked
+        int signed_count = hash_failure == -1 ? n : hash_failure;
+        int signature_failure = -1;
 
-        if (!verify_signature(original_hash,
-                              public_key_path,
-                              curr.validator_signature))
+        for (int k = 0; k < signed_count; k++)
         {
-            printf("[CRYPTO] Signature validation failed at block %d.\n",
-                   curr.index);
-            fclose(fp);
-            pthread_mutex_unlock(&blockchain_lock);
-            return 0;
+            snprintf(vw->public_key_paths[k], sizeof(vw->public_key_paths[k]),
+                     "keys/%d_public.pem", vw->blocks[k].validator_port);
+
+            digest_to_hex(&vw->blocks[k].block_hash, vw->hash_hex[k]);
+
+            vw->checks[k].data = vw->hash_hex[k];
+            vw->checks[k].public_key_path = vw->public_key_paths[k];
+            vw->checks[k].signature_hex = vw->blocks[k].validator_signature;
+        }
+
+        if (signed_count > 0 &&
+            verify_signatures_batch(vw->checks, signed_count, vw->results) != signed_count)
+        {
+            for (int k = 0; k < signed_count; k++)
+            {
+                if (!SIGNATURE_BIT(vw->results, k))
+                {
+                    signature_failure = k;
+                    break;
+                }
+            }
+        }
+
+        // report the earliest failure in chain order
+        if (signature_failure != -1)
+        {
+            if (window + signature_failure == 0)
+                printf("[CRYPTO] Genesis signature validation failed.\n");
+            else
+                printf("[CRYPTO] Signature validation failed at block %d.\n",
+                       vw->blocks[signature_failure].index);
+            valid = 0;
+        }
+        else if (hash_failure != -1)
+        {
+            if (window + hash_failure == 0)
+                printf("[BLOCKCHAIN] Genesis hash validation failed.\n");
+            else
+                printf("[BLOCKCHAIN] Hash validation failed at block %d.\n",
+                       vw->blocks[hash_failure].index);
+            valid = 0;
+        }
+        else if (failure[0])
+        {
+            fputs(failure, stdout);
+            valid = 0;
         }
 
-        strcpy(stored_hash, original_hash);
-        prev = curr;
+        for (int k = 0; k < n; k++)
+            free_block(&vw->blocks[k]);
+
+        window += n;
     }
 
-    fclose(fp);
-    pthread_mutex_unlock(&blockchain_lock);
+    free(vw);
 
-    return 1;
+    return valid;
 }
 
-// get chain length
-int get_blockchain_height()
+// verify from the watermark and advance it
+static int verify_chain_from_checkpoint_locked()
 {
-    pthread_mutex_lock(&blockchain_lock);
+    if (!load_block_index_locked() || index_count == 0)
+        return 0;
 
-    FILE *fp = fopen(blockchain_file, "rb");
-    if (!fp)
+    Digest prev_hash;
+    int start = 0;
+
+    memset(&prev_hash, 0, sizeof(prev_hash));
+
+    load_checkpoint_locked();
+
+    int height = (int)checkpoint.verified_height;
+
+    if (height > 0 && height <= index_count)
     {
-        pthread_mutex_unlock(&blockchain_lock);
+        Block tip;
+
+        // the watermark only counts if the block under it is unchanged
+        int unchanged = read_block_at(index_entries[height - 1].offset, &tip, NULL);
+
+        if (unchanged)
+        {
+            unchanged = digest_equal(&tip.block_hash, &checkpoint.tip_hash);
+            free_block(&tip);
+        }
+
+        if (unchanged)
+        {
+            start = height;
+            prev_hash = checkpoint.tip_hash;
+        }
+        else
+        {
+            printf("[BLOCKCHAIN] Verification checkpoint is stale. Verifying from genesis.\n");
+        }
+    }
+
+    if (start == index_count)
+        return 1;
+
+    if (!verify_range_locked(start, &prev_hash))
+    {
+        // a failed audit from genesis must not leave a watermark behind
+        if (start == 0)
+            save_checkpoint_locked(0, NULL);
         return 0;
     }
 
-    int count = 0;
-    Block temp;
+    save_checkpoint_locked(index_count, &prev_hash);
+    return 1;
+}
 
-    while (fread(&temp, sizeof(Block), 1, fp) == 1)
-        count++;
+// validate blocks added since the last successful verification
+int verify_blockchain()
+{
+    pthread_mutex_lock(&blockchain_lock);
+    int valid = verify_chain_from_checkpoint_locked();
+    pthread_mutex_unlock(&blockchain_lock);
+
+    return valid;
+}
+
+// validate the entire chain from genesis on all cores, without blocking appends
+int verify_blockchain_full()
+{
+    char path[sizeof(blockchain_file)];
+
+    pthread_mutex_lock(&blockchain_lock);
+    int loaded = load_block_index_locked();
+    strcpy(path, blockchain_file);
+    pthread_mutex_unlock(&blockchain_lock);
+
+    if (!loaded)
+        return 0;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    ChainAudit audit;
+    int valid = audit_chain_parallel(path, cores > 0 ? (int)cores : 1, &audit);
+
+    pthread_mutex_lock(&blockchain_lock);
+
+    if (valid)
+        save_checkpoint_locked(audit.height, &audit.tip_hash);
+    else
+        save_checkpoint_locked(0, NULL);
 
-    fclose(fp);
     pthread_mutex_unlock(&blockchain_lock);
 
-    return count;
+    return valid;
+}
+
+// get chain length
+int get_blockchain_height()
+{
+    if (!ensure_chain_loaded())
+        return 0;
+
+    pthread_rwlock_rdlock(&tip_lock);
+    int height = chain_height;
+    pthread_rwlock_unlock(&tip_lock);
+
+    return height;
 }
 
-// find block by index
+// find block by index; the caller frees the block
 int get_block_by_index(int index, Block *block)
 {
     pthread_mutex_lock(&blockchain_lock);
 
-    FILE *fp = fopen(blockchain_file, "rb");
-    if (!fp)
+    if (!load_block_index_locked() ||
+        index < 0 || index >= lookup_capacity ||
+        index_lookup[index] == -1)
     {
         pthread_mutex_unlock(&blockchain_lock);
         return 0;
     }
 
-    Block temp;
-
-    while (fread(&temp, sizeof(Block), 1, fp) == 1)
-    {
-        if (temp.index == index)
-        {
-            *block = temp;
-            fclose(fp);
-            pthread_mutex_unlock(&blockchain_lock);
-            return 1;
-        }
-    }
+    int found = read_block_at(index_entries[index_lookup[index]].offset,
+                              block, NULL);
 
-    fclose(fp);
     pthread_mutex_unlock(&blockchain_lock);
 
-    return 0;
+    return found;
 }
 
 // check if block exists
@@ -283,60 +1034,181 @@ int block_exists_by_index(int index)
 {
     pthread_mutex_lock(&blockchain_lock);
 
-    FILE *fp = fopen(blockchain_file, "rb");
-    if (!fp)
-    {
-        pthread_mutex_unlock(&blockchain_lock);
-        return 0;
-    }
+    int exists = load_block_index_locked() &&
+                 index >= 0 && index < lookup_capacity &&
+                 index_lookup[index] != -1;
 
-    Block temp;
+    pthread_mutex_unlock(&blockchain_lock);
+
+    return exists;
+}
+
+// checking for duplicate transactions
+int transaction_hash_exists(const Digest *data_hash)
+{
+    pthread_mutex_lock(&blockchain_lock);
+
+    int exists = load_block_index_locked() &&
+                 digest_set_contains(&tx_index, data_hash->bytes);
+
+    pthread_mutex_unlock(&blockchain_lock);
+
+    return exists;
+}
+
+// locate the block holding a transaction; the digest set names the block,
+// so only that one is read. The caller frees the block on success
+int find_transaction(const Digest *data_hash, Block *block, int *position)
+{
+    pthread_mutex_lock(&blockchain_lock);
+
+    int found = 0;
+    uint32_t index;
 
-    while (fread(&temp, sizeof(Block), 1, fp) == 1)
+    if (load_block_index_locked() &&
+        digest_set_find(&tx_index, data_hash->bytes, &index) &&
+        index < (uint32_t)lookup_capacity && index_lookup[index] != -1 &&
+        read_block_at(index_entries[index_lookup[index]].offset, block, NULL))
     {
-        if (temp.index == index)
+        for (int k = 0; k < block->transaction_count; k++)
         {
-            fclose(fp);
-            pthread_mutex_unlock(&blockchain_lock);
-            return 1;
+            if (digest_equal(&block->transactions[k].data_hash, data_hash))
+            {
+                *position = k;
+                found = 1;
+                break;
+            }
         }
+
+        if (!found)
+            free_block(block);
     }
 
-    fclose(fp);
     pthread_mutex_unlock(&blockchain_lock);
 
-    return 0;
+    return found;
 }
 
-// checking for duplicate transactions
-int transaction_hash_exists(const char *data_hash)
+// append the certificate that committed a block to the .qcs sidecar
+int store_quorum_certificate(const QuorumCertificate *qc)
 {
-    pthread_mutex_lock(&blockchain_lock);
+    unsigned char *record = malloc(QUORUM_RECORD_MAX);
+    size_t len = record ? encode_quorum_record(qc, record, QUORUM_RECORD_MAX) : 0;
 
-    FILE *fp = fopen(blockchain_file, "rb");
-    if (!fp)
+    if (len == 0)
     {
-        pthread_mutex_unlock(&blockchain_lock);
+        free(record);
         return 0;
     }
 
-    Block temp;
+    pthread_mutex_lock(&blockchain_lock);
+
+    int fd = open(quorum_file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    int ok = fd >= 0 && write(fd, record, len) == (ssize_t)len;
+
+    if (fd >= 0)
+        close(fd);
+
+    pthread_mutex_unlock(&blockchain_lock);
+
+    free(record);
+
+    if (!ok)
+        printf("[STORAGE] Failed to store quorum certificate for block %d.\n", qc->index);
+
+    return ok;
+}
+
+// read the certificate record at a .qcs offset; record_len is set once the
+// whole record is there, even if it does not decode
+static int read_quorum_record_at(int fd, off_t offset, unsigned char *record,
+                                 QuorumCertificate *qc, size_t *record_len)
+{
+    if (record_len)
+        *record_len = 0;
+
+    if (pread(fd, record, 4, offset) != 4)
+        return 0;
+
+    size_t body = record[0] | (record[1] << 8) |
+                  ((size_t)record[2] << 16) | ((size_t)record[3] << 24);
+
+    if (body > QUORUM_RECORD_MAX - 4 ||
+        pread(fd, record + 4, body, offset + 4) != (ssize_t)body)
+        return 0;
+
+    if (record_len)
+        *record_len = 4 + body;
+
+    return decode_quorum_record(record, body + 4, qc, NULL);
+}
+
+// index certificates appended since the last scan; later records win
+static void scan_quorum_records_locked(int fd, unsigned char *record,
+                                       QuorumCertificate *candidate)
+{
+    size_t record_len;
 
-    while (fread(&temp, sizeof(Block), 1, fp) == 1)
+    while (1)
     {
-        for (int i = 0; i < temp.transaction_count; i++)
+        int decoded = read_quorum_record_at(fd, qc_scanned, record, candidate, &record_len);
+
+        // a torn tail is picked up once it is complete
+        if (record_len == 0)
+            break;
+
+        int index = decoded ? candidate->index : -1;
+
+        if (index >= 0 && index >= qc_offset_capacity)
         {
-            if (strcmp(temp.transactions[i].data_hash,
-                       data_hash) == 0)
-            {
-                fclose(fp);
-                pthread_mutex_unlock(&blockchain_lock);
-                return 1;
-            }
+            int new_capacity = qc_offset_capacity ? qc_offset_capacity : 256;
+            while (new_capacity <= index)
+                new_capacity *= 2;
+
+            off_t *offsets = realloc(qc_offsets, new_capacity * sizeof(off_t));
+            if (!offsets)
+                return;
+
+            for (int i = qc_offset_capacity; i < new_capacity; i++)
+                offsets[i] = -1;
+
+            qc_offsets = offsets;
+            qc_offset_capacity = new_capacity;
         }
+
+        if (index >= 0)
+            qc_offsets[index] = qc_scanned;
+
+        qc_scanned += record_len;
+    }
+}
+
+// newest stored certificate for a block index
+int get_quorum_certificate(int index, QuorumCertificate *qc)
+{
+    pthread_mutex_lock(&blockchain_lock);
+
+    int fd = open(quorum_file, O_RDONLY);
+    unsigned char *record = malloc(QUORUM_RECORD_MAX);
+    QuorumCertificate *candidate = malloc(sizeof(QuorumCertificate));
+    int found = 0;
+
+    if (fd >= 0 && record && candidate)
+    {
+        scan_quorum_records_locked(fd, record, candidate);
+
+        found = index >= 0 && index < qc_offset_capacity &&
+                qc_offsets[index] >= 0 &&
+                read_quorum_record_at(fd, qc_offsets[index], record, qc, NULL);
     }
 
-    fclose(fp);
+    if (fd >= 0)
+        close(fd);
+
+    free(candidate);
+    free(record);
+
     pthread_mutex_unlock(&blockchain_lock);
-    return 0;
+
+    return found;
 }
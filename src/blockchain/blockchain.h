@@ -2,17 +2,23 @@
 #define BLOCKCHAIN_H
 
 #include "block.h"
+#include "quorum.h"
 
 void create_genesis_block(Block *block, int validator_port);
-void add_block(Block *new_block);
+int block_authentic(const Block *block);
+int add_block(Block *new_block);
 int get_last_block(Block *last_block);
 int verify_blockchain();
-int get_last_block_hash(char *output_hash);
+int verify_blockchain_full();
+int get_last_block_hash(Digest *output_hash);
 int get_blockchain_height();
 int get_block_by_index(int index, Block *block);
 void set_blockchain_file(const char *filename);
 int block_exists_by_index(int index);
-int transaction_hash_exists(const char *data_hash);
+int transaction_hash_exists(const Digest *data_hash);
+int find_transaction(const Digest *data_hash, Block *block, int *position);
+int store_quorum_certificate(const QuorumCertificate *qc);
+int get_quorum_certificate(int index, QuorumCertificate *qc);
 
 
 
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "chain_view.h"
+#include "storage.h"
+
+// mappings grow in steps so appends rarely force a remap
+#define VIEW_MAP_STEP (1 << 20)
+
+static uint32_t read_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// (re)map the file so that at least file_size bytes are covered
+int chain_view_remap(ChainView *view)
+{
+    struct stat st;
+    if (fstat(view->fd, &st) != 0)
+        return 0;
+
+    view->file_size = st.st_size;
+
+    if (view->map && view->file_size <= view->map_len)
+        return 1;
+
+    size_t len = (view->file_size / VIEW_MAP_STEP + 1) * VIEW_MAP_STEP;
+
+    // pages past end of file are never touched, only reserved
+    unsigned char *map = mmap(NULL, len, PROT_READ, MAP_SHARED, view->fd, 0);
+    if (map == MAP_FAILED)
+        return 0;
+
+    if (view->map)
+        munmap(view->map, view->map_len);
+
+    view->map = map;
+    view->map_len = len;
+
+    return 1;
+}
+
+// map an already open chain descriptor; offsets are not scanned
+int chain_view_attach(ChainView *view, int fd)
+{
+    memset(view, 0, sizeof(*view));
+    view->fd = fd;
+    view->scanned = CHAIN_HEADER_SIZE;
+
+    if (!chain_view_remap(view))
+        return 0;
+
+    if (!check_chain_header(view->map, view->file_size))
+    {
+        chain_view_close(view);
+        return 0;
+    }
+
+    return 1;
+}
+
+// open a chain file read-only and index every complete record
+int chain_view_open(ChainView *view, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    if (!chain_view_attach(view, fd))
+    {
+        close(fd);
+        printf("[STORAGE] %s is not in the current chain format. Run migrate_chain.\n",
+               path);
+        return 0;
+    }
+
+    view->owns_fd = 1;
+
+    return chain_view_refresh(view);
+}
+
+// pick up records appended since the last scan
+int chain_view_refresh(ChainView *view)
+{
+    if (!chain_view_remap(view))
+        return 0;
+
+    while ((size_t)view->scanned + 4 <= view->file_size)
+    {
+        uint32_t body = read_u32(view->map + view->scanned);
+
+        if (body > BLOCK_RECORD_MAX ||
+            (size_t)view->scanned + 4 + body > view->file_size)
+            break;
+
+        if (view->count == view->capacity)
+        {
+            int new_capacity = view->capacity ? view->capacity * 2 : 256;
+            off_t *offsets = realloc(view->offsets, new_capacity * sizeof(off_t));
+            if (!offsets)
+                return 0;
+
+            view->offsets = offsets;
+            view->capacity = new_capacity;
+        }
+
+        view->offsets[view->count++] = view->scanned;
+        view->scanned += 4 + body;
+    }
+
+    return 1;
+}
+
+void chain_view_close(ChainView *view)
+{
+    if (view->map)
+        munmap(view->map, view->map_len);
+    if (view->owns_fd && view->fd >= 0)
+        close(view->fd);
+
+    free(view->offsets);
+    memset(view, 0, sizeof(*view));
+    view->fd = -1;
+}
+
+// zero-copy access to the record starting at a byte offset
+int chain_view_at(ChainView *view, off_t offset, BlockRecordRef *ref)
+{
+    if (offset < CHAIN_HEADER_SIZE)
+        return 0;
+
+    // the file may have grown past the mapping since it was built
+    if ((size_t)offset + 4 > view->file_size && !chain_view_remap(view))
+        return 0;
+
+    if ((size_t)offset + 4 > view->file_size)
+        return 0;
+
+    uint32_t body = read_u32(view->map + offset);
+
+    if (body > BLOCK_RECORD_MAX)
+        return 0;
+
+    if ((size_t)offset + 4 + body > view->file_size &&
+        (!chain_view_remap(view) || (size_t)offset + 4 + body > view->file_size))
+        return 0;
+
+    ref->data = view->map + offset;
+    ref->len = 4 + body;
+    ref->offset = offset;
+
+    return 1;
+}
+
+// zero-copy access by position among scanned records
+int chain_view_record(ChainView *view, int position, BlockRecordRef *ref)
+{
+    if (position < 0 || position >= view->count)
+        return 0;
+
+    return chain_view_at(view, view->offsets[position], ref);
+}
+
+// decode the record at a position; the caller frees the block
+int chain_view_block(ChainView *view, int position, Block *block)
+{
+    BlockRecordRef ref;
+
+    if (!chain_view_record(view, position, &ref))
+        return 0;
+
+    return decode_block_record(ref.data, ref.len, block, NULL);
+}
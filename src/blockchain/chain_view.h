@@ -0,0 +1,40 @@
+#ifndef CHAIN_VIEW_H
+#define CHAIN_VIEW_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "block.h"
+
+// one stored record, pointing straight into the mapping
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    off_t offset;
+} BlockRecordRef;
+
+// read-only memory-mapped view of a chain file
+typedef struct {
+    int fd;
+    int owns_fd;
+    unsigned char *map;
+    size_t map_len;       // mapped bytes, may run past end of file
+    size_t file_size;     // bytes known to exist on disk
+
+    off_t *offsets;       // record start offsets, filled by scanning
+    int count;
+    int capacity;
+    off_t scanned;        // end of the last complete record scanned
+} ChainView;
+
+int chain_view_open(ChainView *view, const char *path);
+int chain_view_attach(ChainView *view, int fd);
+int chain_view_remap(ChainView *view);
+int chain_view_refresh(ChainView *view);
+void chain_view_close(ChainView *view);
+
+int chain_view_at(ChainView *view, off_t offset, BlockRecordRef *ref);
+int chain_view_record(ChainView *view, int position, BlockRecordRef *ref);
+int chain_view_block(ChainView *view, int position, Block *block);
+
+#endif
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "digest_set.h"
+
+#define DIGEST_SET_MAGIC "MRDSET02"
+#define DIGEST_SET_MIN_CAPACITY 1024
+
+static const unsigned char zero_digest[DIGEST_SIZE];
+
+// bytes needed for a table of the given capacity
+static size_t table_bytes(uint64_t capacity)
+{
+    return sizeof(DigestSetHeader) + (size_t)capacity * (DIGEST_SIZE + sizeof(uint32_t));
+}
+
+// digests are uniformly distributed, so the prefix is a good hash
+static uint64_t slot_hash(const unsigned char *digest)
+{
+    uint64_t h;
+    memcpy(&h, digest, sizeof(h));
+    return h;
+}
+
+// map a table of the given capacity, backed by a file or anonymous memory
+static int map_table(DigestSet *set, const char *path, uint64_t capacity, int fresh)
+{
+    size_t len = table_bytes(capacity);
+    unsigned char *map;
+    int fd = -1;
+
+    if (path && path[0])
+    {
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return 0;
+
+        if (fresh && ftruncate(fd, 0) != 0)
+        {
+            close(fd);
+            return 0;
+        }
+
+        if (ftruncate(fd, len) != 0)
+        {
+            close(fd);
+            return 0;
+        }
+
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    else
+    {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (map == MAP_FAILED)
+    {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+
+    set->fd = fd;
+    set->map = map;
+    set->map_len = len;
+    set->header = (DigestSetHeader *)map;
+    set->slots = map + sizeof(DigestSetHeader);
+    set->values = (uint32_t *)(set->slots + (size_t)capacity * DIGEST_SIZE);
+
+    if (fresh)
+    {
+        memset(set->header, 0, sizeof(DigestSetHeader));
+        memcpy(set->header->magic, DIGEST_SET_MAGIC, sizeof(set->header->magic));
+        set->header->capacity = capacity;
+    }
+
+    return 1;
+}
+
+static void unmap_table(DigestSet *set)
+{
+    if (set->map)
+        munmap(set->map, set->map_len);
+    if (set->fd >= 0)
+        close(set->fd);
+
+    set->fd = -1;
+    set->map = NULL;
+    set->map_len = 0;
+    set->header = NULL;
+    set->slots = NULL;
+    set->values = NULL;
+}
+
+// probe for a digest; returns its slot or the empty slot ending the run
+static uint64_t find_slot(const DigestSet *set, const unsigned char *digest)
+{
+    uint64_t mask = set->header->capacity - 1;
+    uint64_t slot = slot_hash(digest) & mask;
+
+    while (1)
+    {
+        const unsigned char *entry = set->slots + slot * DIGEST_SIZE;
+
+        if (memcmp(entry, digest, DIGEST_SIZE) == 0 ||
+            memcmp(entry, zero_digest, DIGEST_SIZE) == 0)
+            return slot;
+
+        slot = (slot + 1) & mask;
+    }
+}
+
+// double the table, rehashing into a fresh file swapped in by rename
+static int grow_table(DigestSet *set)
+{
+    DigestSet bigger;
+    char tmp_path[sizeof(set->path) + 8] = "";
+
+    memset(&bigger, 0, sizeof(bigger));
+    bigger.fd = -1;
+
+    if (set->path[0])
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", set->path);
+
+    if (!map_table(&bigger, tmp_path, set->header->capacity * 2, 1))
+        return 0;
+
+    for (uint64_t i = 0; i < set->header->capacity; i++)
+    {
+        const unsigned char *entry = set->slots + i * DIGEST_SIZE;
+
+        if (memcmp(entry, zero_digest, DIGEST_SIZE) == 0)
+            continue;
+
+        uint64_t slot = find_slot(&bigger, entry);
+        memcpy(bigger.slots + slot * DIGEST_SIZE, entry, DIGEST_SIZE);
+        bigger.values[slot] = set->values[i];
+    }
+
+    bigger.header->count = set->header->count;
+    bigger.header->indexed_blocks = set->header->indexed_blocks;
+    bigger.header->has_zero_key = set->header->has_zero_key;
+    bigger.header->zero_value = set->header->zero_value;
+
+    // the copied watermark must not reach disk ahead of the rehashed slots
+    if (tmp_path[0] &&
+        (msync(bigger.map, bigger.map_len, MS_SYNC) != 0 ||
+         rename(tmp_path, set->path) != 0))
+    {
+        unmap_table(&bigger);
+        unlink(tmp_path);
+        return 0;
+    }
+
+    unmap_table(set);
+
+    set->fd = bigger.fd;
+    set->map = bigger.map;
+    set->map_len = bigger.map_len;
+    set->header = bigger.header;
+    set->slots = bigger.slots;
+    set->values = bigger.values;
+
+    return 1;
+}
+
+// open a persistent set at path, or a memory-only set when path is NULL
+int digest_set_open(DigestSet *set, const char *path, size_t min_capacity)
+{
+    memset(set, 0, sizeof(*set));
+    set->fd = -1;
+
+    if (path)
+        snprintf(set->path, sizeof(set->path), "%s", path);
+
+    uint64_t capacity = DIGEST_SET_MIN_CAPACITY;
+    while (capacity < min_capacity * 2)
+        capacity *= 2;
+
+    // reuse an existing table when its header is sane
+    if (path)
+    {
+        struct stat st;
+        DigestSetHeader header;
+        int fd = open(path, O_RDONLY);
+
+        if (fd >= 0)
+        {
+            int valid = fstat(fd, &st) == 0 &&
+                        pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                        memcmp(header.magic, DIGEST_SET_MAGIC, sizeof(header.magic)) == 0 &&
+                        header.capacity >= DIGEST_SET_MIN_CAPACITY &&
+                        (header.capacity & (header.capacity - 1)) == 0 &&
+                        header.count < header.capacity &&
+                        (size_t)st.st_size == table_bytes(header.capacity);
+            close(fd);
+
+            if (valid && map_table(set, path, header.capacity, 0))
+                return 1;
+
+            printf("[STORAGE] Transaction index %s unusable. Rebuilding.\n", path);
+        }
+    }
+
+    return map_table(set, path, capacity, 1);
+}
+
+void digest_set_close(DigestSet *set)
+{
+    unmap_table(set);
+}
+
+// empty the set, keeping its current capacity
+int digest_set_clear(DigestSet *set)
+{
+    memset(set->slots, 0, (size_t)set->header->capacity * DIGEST_SIZE);
+
+    set->header->count = 0;
+    set->header->indexed_blocks = 0;
+    set->header->has_zero_key = 0;
+    set->header->zero_value = 0;
+
+    return 1;
+}
+
+// write dirty slots and header to disk; a no-op for memory-only sets
+int digest_set_sync(DigestSet *set)
+{
+    if (!set->header)
+        return 0;
+
+    if (set->fd < 0)
+        return 1;
+
+    return msync(set->map, set->map_len, MS_SYNC) == 0;
+}
+
+// membership test in expected constant time
+int digest_set_contains(const DigestSet *set, const unsigned char *digest)
+{
+    if (!set->header)
+        return 0;
+
+    if (memcmp(digest, zero_digest, DIGEST_SIZE) == 0)
+        return set->header->has_zero_key != 0;
+
+    uint64_t slot = find_slot(set, digest);
+    return memcmp(set->slots + slot * DIGEST_SIZE, digest, DIGEST_SIZE) == 0;
+}
+
+// value stored with a digest; 0 when the digest is absent
+int digest_set_find(const DigestSet *set, const unsigned char *digest, uint32_t *value)
+{
+    if (!set->header)
+        return 0;
+
+    if (memcmp(digest, zero_digest, DIGEST_SIZE) == 0)
+    {
+        if (!set->header->has_zero_key)
+            return 0;
+
+        *value = set->header->zero_value;
+        return 1;
+    }
+
+    uint64_t slot = find_slot(set, digest);
+
+    if (memcmp(set->slots + slot * DIGEST_SIZE, digest, DIGEST_SIZE) != 0)
+        return 0;
+
+    *value = set->values[slot];
+    return 1;
+}
+
+// insert a digest with its value; returns 1 if added, 0 if already present
+// (the first value is kept), -1 on error
+int digest_set_insert(DigestSet *set, const unsigned char *digest, uint32_t value)
+{
+    if (!set->header)
+        return -1;
+
+    if (memcmp(digest, zero_digest, DIGEST_SIZE) == 0)
+    {
+        if (set->header->has_zero_key)
+            return 0;
+
+        set->header->has_zero_key = 1;
+        set->header->zero_value = value;
+        set->header->count++;
+        return 1;
+    }
+
+    // keep the load factor at or below one half
+    if ((set->header->count + 1) * 2 > set->header->capacity &&
+        !grow_table(set))
+        return -1;
+
+    uint64_t slot = find_slot(set, digest);
+    unsigned char *entry = set->slots + slot * DIGEST_SIZE;
+
+    if (memcmp(entry, digest, DIGEST_SIZE) == 0)
+        return 0;
+
+    memcpy(entry, digest, DIGEST_SIZE);
+    set->values[slot] = value;
+    set->header->count++;
+
+    return 1;
+}
+
+// remove a digest, shifting later entries of its probe run back so lookups
+// never stop at the hole; returns 1 if removed, 0 if absent, -1 on error
+int digest_set_remove(DigestSet *set, const unsigned char *digest)
+{
+    if (!set->header)
+        return -1;
+
+    if (memcmp(digest, zero_digest, DIGEST_SIZE) == 0)
+    {
+        if (!set->header->has_zero_key)
+            return 0;
+
+        set->header->has_zero_key = 0;
+        set->header->count--;
+        return 1;
+    }
+
+    uint64_t mask = set->header->capacity - 1;
+    uint64_t hole = find_slot(set, digest);
+
+    if (memcmp(set->slots + hole * DIGEST_SIZE, digest, DIGEST_SIZE) != 0)
+        return 0;
+
+    uint64_t next = hole;
+
+    while (1)
+    {
+        next = (next + 1) & mask;
+        unsigned char *entry = set->slots + next * DIGEST_SIZE;
+
+        if (memcmp(entry, zero_digest, DIGEST_SIZE) == 0)
+            break;
+
+        // an entry whose home lies cyclically in (hole, next] stays put
+        uint64_t home = slot_hash(entry) & mask;
+        int stays = hole <= next ? (home > hole && home <= next)
+                                 : (home > hole || home <= next);
+
+        if (stays)
+            continue;
+
+        memcpy(set->slots + hole * DIGEST_SIZE, entry, DIGEST_SIZE);
+        set->values[hole] = set->values[next];
+        hole = next;
+    }
+
+    memset(set->slots + hole * DIGEST_SIZE, 0, DIGEST_SIZE);
+    set->header->count--;
+
+    return 1;
+}
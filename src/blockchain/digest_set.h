@@ -0,0 +1,39 @@
+#ifndef DIGEST_SET_H
+#define DIGEST_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../crypto/hash.h"
+
+// on-disk / in-memory header of an open-addressing digest set; every
+// slot carries a 32-bit value stored after the digest table
+typedef struct {
+    char magic[8];
+    uint64_t capacity;        // slot count, power of two
+    uint64_t count;           // stored digests
+    uint64_t indexed_blocks;  // chain records already folded in
+    uint32_t has_zero_key;    // all-zero digest marks empty slots
+    uint32_t zero_value;      // value of the all-zero digest
+} DigestSetHeader;
+
+typedef struct {
+    char path[160];           // empty for memory-only sets
+    int fd;
+    unsigned char *map;
+    size_t map_len;
+    DigestSetHeader *header;
+    unsigned char *slots;
+    uint32_t *values;         // one per slot
+} DigestSet;
+
+int digest_set_open(DigestSet *set, const char *path, size_t min_capacity);
+void digest_set_close(DigestSet *set);
+int digest_set_clear(DigestSet *set);
+int digest_set_sync(DigestSet *set);
+int digest_set_contains(const DigestSet *set, const unsigned char *digest);
+int digest_set_find(const DigestSet *set, const unsigned char *digest, uint32_t *value);
+int digest_set_insert(DigestSet *set, const unsigned char *digest, uint32_t value);
+int digest_set_remove(DigestSet *set, const unsigned char *digest);
+
+#endif
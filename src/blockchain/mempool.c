@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mempool.h"
+#include "blockchain.h"
+#include "digest_set.h"
+
+// one pending transaction, when it arrived and the batch holding it
+typedef struct {
+    Transaction tx;
+    struct timespec added;
+    int batch;            // 0 while waiting for a block
+} MempoolEntry;
+
+// entries are kept in arrival order; several batches can be in flight
+static MempoolEntry *entries = NULL;
+static int entry_count = 0;
+static int waiting_count = 0;
+static int next_batch = 1;
+
+static int pool_capacity = 0;
+static int pool_batch_size = 0;
+static int pool_deadline_ms = 0;
+static int initialized = 0;
+static int stopping = 0;
+
+// hashes of every pending and in-flight transaction
+static DigestSet pending_hashes;
+
+static pthread_mutex_t mempool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mempool_ready = PTHREAD_COND_INITIALIZER;
+
+// allocate the pool; batch size is clamped to what a block can hold
+int mempool_init(int capacity, int batch_size, int deadline_ms)
+{
+    if (capacity <= 0 || batch_size <= 0 || deadline_ms < 0)
+        return 0;
+
+    if (batch_size > MAX_TRANSACTIONS)
+        batch_size = MAX_TRANSACTIONS;
+
+    pthread_mutex_lock(&mempool_lock);
+
+    if (initialized)
+    {
+        pthread_mutex_unlock(&mempool_lock);
+        return 1;
+    }
+
+    entries = malloc(sizeof(MempoolEntry) * capacity);
+
+    if (!entries || !digest_set_open(&pending_hashes, NULL, capacity))
+    {
+        free(entries);
+        entries = NULL;
+        pthread_mutex_unlock(&mempool_lock);
+        printf("[MEMPOOL] Initialization failed.\n");
+        return 0;
+    }
+
+    entry_count = 0;
+    waiting_count = 0;
+    pool_capacity = capacity;
+    pool_batch_size = batch_size;
+    pool_deadline_ms = deadline_ms;
+    stopping = 0;
+    initialized = 1;
+
+    pthread_mutex_unlock(&mempool_lock);
+    return 1;
+}
+
+// wake every waiter; mempool_wait_batch returns 0 from now on
+void mempool_shutdown()
+{
+    pthread_mutex_lock(&mempool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&mempool_ready);
+    pthread_mutex_unlock(&mempool_lock);
+}
+
+// release the pool once no thread uses it any more
+void mempool_close()
+{
+    pthread_mutex_lock(&mempool_lock);
+
+    if (initialized)
+    {
+        digest_set_close(&pending_hashes);
+        free(entries);
+        entries = NULL;
+        entry_count = 0;
+        waiting_count = 0;
+        initialized = 0;
+    }
+
+    pthread_mutex_unlock(&mempool_lock);
+}
+
+// queue a transaction unless it is already pending or on chain
+int mempool_add(const Transaction *tx)
+{
+    // checked before taking the pool lock; mempool_take filters again
+    if (transaction_hash_exists(&tx->data_hash))
+        return MEMPOOL_ON_CHAIN;
+
+    pthread_mutex_lock(&mempool_lock);
+
+    int result;
+
+    if (!initialized || stopping)
+    {
+        result = MEMPOOL_ERROR;
+    }
+    else if (digest_set_contains(&pending_hashes, tx->data_hash.bytes))
+    {
+        result = MEMPOOL_DUPLICATE;
+    }
+    else if (entry_count >= pool_capacity)
+    {
+        result = MEMPOOL_FULL;
+    }
+    else if (digest_set_insert(&pending_hashes, tx->data_hash.bytes, 0) < 0)
+    {
+        result = MEMPOOL_ERROR;
+    }
+    else
+    {
+        MempoolEntry *entry = &entries[entry_count++];
+        entry->tx = *tx;
+        entry->batch = 0;
+        clock_gettime(CLOCK_REALTIME, &entry->added);
+        waiting_count++;
+
+        pthread_cond_signal(&mempool_ready);
+        result = MEMPOOL_ADDED;
+    }
+
+    pthread_mutex_unlock(&mempool_lock);
+    return result;
+}
+
+// deadline of the oldest entry not yet in flight
+static struct timespec batch_deadline()
+{
+    int oldest = 0;
+
+    while (oldest < entry_count - 1 && entries[oldest].batch != 0)
+        oldest++;
+
+    struct timespec deadline = entries[oldest].added;
+
+    deadline.tv_sec += pool_deadline_ms / 1000;
+    deadline.tv_nsec += (long)(pool_deadline_ms % 1000) * 1000000L;
+
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    return deadline;
+}
+
+static int deadline_passed(const struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return now.tv_sec > deadline->tv_sec ||
+           (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+// wait up to timeout_ms until a full batch is pending or the oldest entry
+// hits its deadline; returns 1 when a batch is ready, 0 on timeout and
+// -1 once the pool is shut down
+int mempool_wait_batch(int timeout_ms)
+{
+    struct timespec limit;
+    clock_gettime(CLOCK_REALTIME, &limit);
+
+    limit.tv_sec += timeout_ms / 1000;
+    limit.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+
+    if (limit.tv_nsec >= 1000000000L)
+    {
+        limit.tv_sec++;
+        limit.tv_nsec -= 1000000000L;
+    }
+
+    int ready = 0;
+
+    pthread_mutex_lock(&mempool_lock);
+
+    while (initialized && !stopping)
+    {
+        if (waiting_count >= pool_batch_size)
+        {
+            ready = 1;
+            break;
+        }
+
+        struct timespec wake = limit;
+
+        if (waiting_count > 0)
+        {
+            struct timespec deadline = batch_deadline();
+
+            if (deadline_passed(&deadline))
+            {
+                ready = 1;
+                break;
+            }
+
+            if (deadline.tv_sec < wake.tv_sec ||
+                (deadline.tv_sec == wake.tv_sec && deadline.tv_nsec < wake.tv_nsec))
+                wake = deadline;
+        }
+
+        if (deadline_passed(&limit))
+            break;
+
+        pthread_cond_timedwait(&mempool_ready, &mempool_lock, &wake);
+    }
+
+    if (!initialized || stopping)
+        ready = -1;
+
+    pthread_mutex_unlock(&mempool_lock);
+    return ready;
+}
+
+// move the next batch into the block, oldest first; entries that reached
+// the chain meanwhile are dropped. returns the number taken and sets the
+// batch id that mempool_release takes back
+int mempool_take(Block *block, int *batch)
+{
+    pthread_mutex_lock(&mempool_lock);
+
+    *batch = 0;
+
+    if (!initialized)
+    {
+        pthread_mutex_unlock(&mempool_lock);
+        return 0;
+    }
+
+    int id = next_batch++;
+    int kept = 0;
+    int taken = 0;
+    int room = 1;
+
+    for (int i = 0; i < entry_count; i++)
+    {
+        if (entries[i].batch == 0 && room && taken < pool_batch_size)
+        {
+            if (transaction_hash_exists(&entries[i].tx.data_hash))
+            {
+                digest_set_remove(&pending_hashes, entries[i].tx.data_hash.bytes);
+                waiting_count--;
+                continue;
+            }
+
+            // out of memory leaves the rest queued
+            if (add_transaction(block, &entries[i].tx))
+            {
+                entries[i].batch = id;
+                waiting_count--;
+                taken++;
+            }
+            else
+            {
+                room = 0;
+            }
+        }
+
+        entries[kept++] = entries[i];
+    }
+
+    entry_count = kept;
+
+    if (taken > 0)
+        *batch = id;
+
+    pthread_mutex_unlock(&mempool_lock);
+    return taken;
+}
+
+// finish an in-flight batch: committed entries leave the pool and the
+// rest wait for another block, keeping their place in arrival order
+void mempool_release(int batch)
+{
+    pthread_mutex_lock(&mempool_lock);
+
+    if (!initialized || batch == 0)
+    {
+        pthread_mutex_unlock(&mempool_lock);
+        return;
+    }
+
+    int kept = 0;
+
+    for (int i = 0; i < entry_count; i++)
+    {
+        if (entries[i].batch == batch)
+        {
+            if (transaction_hash_exists(&entries[i].tx.data_hash))
+            {
+                digest_set_remove(&pending_hashes, entries[i].tx.data_hash.bytes);
+                continue;
+            }
+
+            entries[i].batch = 0;
+            waiting_count++;
+        }
+
+        entries[kept++] = entries[i];
+    }
+
+    entry_count = kept;
+
+    pthread_cond_signal(&mempool_ready);
+    pthread_mutex_unlock(&mempool_lock);
+}
+
+// transactions waiting or in flight
+int mempool_size()
+{
+    pthread_mutex_lock(&mempool_lock);
+    int size = entry_count;
+    pthread_mutex_unlock(&mempool_lock);
+
+    return size;
+}
@@ -0,0 +1,31 @@
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include "block.h"
+
+// pending transactions the node holds before refusing new ones
+#define MEMPOOL_CAPACITY 8192
+
+// a block is assembled once this many are pending ...
+#define MEMPOOL_BATCH_SIZE 256
+
+// ... or once the oldest pending one has waited this long
+#define MEMPOOL_DEADLINE_MS 500
+
+// mempool_add results
+#define MEMPOOL_ADDED 1
+#define MEMPOOL_DUPLICATE 0
+#define MEMPOOL_ON_CHAIN -1
+#define MEMPOOL_FULL -2
+#define MEMPOOL_ERROR -3
+
+int mempool_init(int capacity, int batch_size, int deadline_ms);
+void mempool_shutdown();
+void mempool_close();
+int mempool_add(const Transaction *tx);
+int mempool_wait_batch(int timeout_ms);
+int mempool_take(Block *block, int *batch);
+void mempool_release(int batch);
+int mempool_size();
+
+#endif
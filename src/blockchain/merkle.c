@@ -0,0 +1,132 @@
+#include <string.h>
+
+#include "merkle.h"
+
+// replace a level with its parents; a lone last node moves up unchanged
+static int reduce_level(Digest *nodes, int count)
+{
+    unsigned char pairs[SHA256_MAX_LANES][1 + 2 * DIGEST_SIZE];
+    const void *data[SHA256_MAX_LANES];
+    size_t lens[SHA256_MAX_LANES];
+    unsigned char digests[SHA256_MAX_LANES][DIGEST_SIZE];
+    int parents = count / 2;
+
+    // sibling pairs are independent, so each level hashes on the lanes
+    for (int base = 0; base < parents; base += SHA256_MAX_LANES)
+    {
+        int n = parents - base;
+        if (n > SHA256_MAX_LANES)
+            n = SHA256_MAX_LANES;
+
+        for (int i = 0; i < n; i++)
+        {
+            int left = 2 * (base + i);
+
+            pairs[i][0] = MERKLE_NODE_TAG;
+            memcpy(pairs[i] + 1, nodes[left].bytes, DIGEST_SIZE);
+            memcpy(pairs[i] + 1 + DIGEST_SIZE, nodes[left + 1].bytes, DIGEST_SIZE);
+
+            data[i] = pairs[i];
+            lens[i] = sizeof(pairs[i]);
+        }
+
+        sha256_digest_many(data, lens, n, digests);
+
+        // parents land below any node a later batch still reads
+        for (int i = 0; i < n; i++)
+            memcpy(nodes[base + i].bytes, digests[i], DIGEST_SIZE);
+    }
+
+    if (count % 2)
+        nodes[parents] = nodes[count - 1];
+
+    return (count + 1) / 2;
+}
+
+// root over the leaf hashes; leaves are overwritten, no leaves gives the zero digest
+int merkle_root(Digest *leaves, int count, Digest *root)
+{
+    if (count < 0)
+        return 0;
+
+    if (count == 0)
+    {
+        memset(root, 0, sizeof(*root));
+        return 1;
+    }
+
+    while (count > 1)
+        count = reduce_level(leaves, count);
+
+    *root = leaves[0];
+    return 1;
+}
+
+// collect the siblings on the path of one leaf; leaves are overwritten
+int merkle_proof(Digest *leaves, int count, int index, MerkleProof *proof)
+{
+    if (count <= 0 || index < 0 || index >= count)
+        return 0;
+
+    memset(proof, 0, sizeof(*proof));
+    proof->leaf_index = index;
+    proof->leaf_count = count;
+
+    while (count > 1)
+    {
+        int sibling = index ^ 1;
+
+        if (sibling < count)
+        {
+            if (proof->depth >= MERKLE_MAX_DEPTH)
+                return 0;
+
+            proof->siblings[proof->depth++] = leaves[sibling];
+        }
+
+        count = reduce_level(leaves, count);
+        index /= 2;
+    }
+
+    return 1;
+}
+
+// fold a leaf up its path and compare with the expected root
+int merkle_verify(const Digest *leaf, const MerkleProof *proof, const Digest *root)
+{
+    int index = proof->leaf_index;
+    int count = proof->leaf_count;
+    int used = 0;
+    unsigned char pair[1 + 2 * DIGEST_SIZE];
+    Digest node = *leaf;
+
+    if (count <= 0 || index < 0 || index >= count ||
+        proof->depth < 0 || proof->depth > MERKLE_MAX_DEPTH)
+        return 0;
+
+    pair[0] = MERKLE_NODE_TAG;
+
+    while (count > 1)
+    {
+        int sibling = index ^ 1;
+
+        if (sibling < count)
+        {
+            if (used >= proof->depth)
+                return 0;
+
+            const Digest *other = &proof->siblings[used++];
+            const Digest *left = (index & 1) ? other : &node;
+            const Digest *right = (index & 1) ? &node : other;
+
+            memcpy(pair + 1, left->bytes, DIGEST_SIZE);
+            memcpy(pair + 1 + DIGEST_SIZE, right->bytes, DIGEST_SIZE);
+            sha256_digest(pair, sizeof(pair), node.bytes);
+        }
+
+        count = (count + 1) / 2;
+        index /= 2;
+    }
+
+    return used == proof->depth && digest_equal(&node, root);
+}
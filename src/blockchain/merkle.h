@@ -0,0 +1,25 @@
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include "../crypto/hash.h"
+
+// deep enough for any leaf count that fits in an int
+#define MERKLE_MAX_DEPTH 32
+
+// domain tags keep leaves and inner nodes from being confused
+#define MERKLE_LEAF_TAG 0x00
+#define MERKLE_NODE_TAG 0x01
+
+// inclusion path of one leaf; the tree shape follows from index and count
+typedef struct {
+    int leaf_index;
+    int leaf_count;
+    int depth;                           // siblings used, lone nodes have none
+    Digest siblings[MERKLE_MAX_DEPTH];   // bottom-up
+} MerkleProof;
+
+int merkle_root(Digest *leaves, int count, Digest *root);
+int merkle_proof(Digest *leaves, int count, int index, MerkleProof *proof);
+int merkle_verify(const Digest *leaf, const MerkleProof *proof, const Digest *root);
+
+#endif
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "quorum.h"
+#include "../crypto/signature.h"
+#include "../crypto/key_registry.h"
+
+// registered validator ports, sorted, so every node assigns the same slots
+static int validator_ports[MAX_VALIDATORS];
+static int validator_total = 0;
+static time_t validators_loaded_at = 0;
+static pthread_mutex_t validator_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the statement a validator signs when it approves a block
+void vote_message(int index, const Digest *block_hash, char out[VOTE_MESSAGE_SIZE])
+{
+    char hash_hex[DIGEST_HEX_SIZE];
+    digest_to_hex(block_hash, hash_hex);
+
+    snprintf(out, VOTE_MESSAGE_SIZE, "VOTE|%d|%s", index, hash_hex);
+}
+
+static int compare_ports(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+// rescan the key directory for <port>_public.pem files
+static void load_validators_locked()
+{
+    DIR *dir = opendir(VALIDATOR_KEY_DIR);
+
+    validator_total = 0;
+    validators_loaded_at = time(NULL);
+
+    if (!dir)
+        return;
+
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL && validator_total < MAX_VALIDATORS)
+    {
+        int port;
+        char suffix[16];
+
+        if (sscanf(entry->d_name, "%d_%15s", &port, suffix) == 2 &&
+            strcmp(suffix, "public.pem") == 0 && port > 0)
+            validator_ports[validator_total++] = port;
+    }
+
+    closedir(dir);
+
+    qsort(validator_ports, validator_total, sizeof(int), compare_ports);
+}
+
+// reload the registry once it is older than the key recheck interval
+static void refresh_validators_locked()
+{
+    if (validators_loaded_at == 0 ||
+        time(NULL) - validators_loaded_at >= KEY_RECHECK_SECONDS)
+        load_validators_locked();
+}
+
+// bitmap slot of a registered validator, -1 for unknown ports
+int validator_slot(int port)
+{
+    pthread_mutex_lock(&validator_lock);
+
+    refresh_validators_locked();
+
+    int slot = -1;
+
+    for (int i = 0; i < validator_total; i++)
+    {
+        if (validator_ports[i] == port)
+        {
+            slot = i;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&validator_lock);
+
+    return slot;
+}
+
+// votes needed to certify a block: a majority of every registered
+// validator, whoever this node happens to be connected to
+int quorum_required()
+{
+    pthread_mutex_lock(&validator_lock);
+
+    refresh_validators_locked();
+    int required = validator_total / 2 + 1;
+
+    pthread_mutex_unlock(&validator_lock);
+
+    return required;
+}
+
+void quorum_init(QuorumCertificate *qc, int index, const Digest *block_hash)
+{
+    qc->index = index;
+    qc->block_hash = *block_hash;
+    qc->vote_count = 0;
+}
+
+// add a vote; one per validator
+int quorum_add_vote(QuorumCertificate *qc, int validator_port, const char *signature)
+{
+    if (qc->vote_count >= MAX_VALIDATORS)
+        return 0;
+
+    for (int i = 0; i < qc->vote_count; i++)
+    {
+        if (qc->votes[i].validator_port == validator_port)
+            return 0;
+    }
+
+    QuorumVote *vote = &qc->votes[qc->vote_count++];
+    vote->validator_port = validator_port;
+    snprintf(vote->signature, sizeof(vote->signature), "%s", signature);
+
+    return 1;
+}
+
+// the certificate must name this block and carry valid signatures from a
+// majority of the registered validators; the block itself must match its
+// merkle root and carry its proposer's signature
+int quorum_verify(const QuorumCertificate *qc, const Block *block)
+{
+    Digest computed;
+    int threshold = quorum_required();
+
+    if (qc->index != block->index ||
+        !digest_equal(&qc->block_hash, &block->block_hash) ||
+        qc->vote_count < threshold ||
+        qc->vote_count > MAX_VALIDATORS)
+        return 0;
+
+    compute_block_hash(block, &computed);
+    if (!digest_equal(&computed, &block->block_hash) ||
+        !block_merkle_valid(block))
+        return 0;
+
+    char message[VOTE_MESSAGE_SIZE];
+    vote_message(qc->index, &qc->block_hash, message);
+
+    // one check per voter plus the proposer's signature over the block hash
+    SignatureCheck checks[MAX_VALIDATORS + 1];
+    char key_paths[MAX_VALIDATORS + 1][64];
+    unsigned char seen[VOTER_BITMAP_SIZE];
+    int count = 0;
+
+    memset(seen, 0, sizeof(seen));
+
+    for (int i = 0; i < qc->vote_count; i++)
+    {
+        int slot = validator_slot(qc->votes[i].validator_port);
+
+        // unknown or repeated voters do not count
+        if (slot < 0 || VOTER_BIT(seen, slot))
+            continue;
+
+        SET_VOTER_BIT(seen, slot);
+
+        snprintf(key_paths[count], sizeof(key_paths[count]),
+                 VALIDATOR_KEY_DIR "/%d_public.pem", qc->votes[i].validator_port);
+
+        checks[count].data = message;
+        checks[count].public_key_path = key_paths[count];
+        checks[count].signature_hex = qc->votes[i].signature;
+        count++;
+    }
+
+    if (count < threshold)
+        return 0;
+
+    char hash_hex[DIGEST_HEX_SIZE];
+    digest_to_hex(&block->block_hash, hash_hex);
+
+    snprintf(key_paths[count], sizeof(key_paths[count]),
+             VALIDATOR_KEY_DIR "/%d_public.pem", block->validator_port);
+
+    checks[count].data = hash_hex;
+    checks[count].public_key_path = key_paths[count];
+    checks[count].signature_hex = block->validator_signature;
+
+    unsigned char results[SIGNATURE_BITMAP_SIZE(MAX_VALIDATORS + 1)];
+    int valid = verify_signatures_batch(checks, count + 1, results);
+
+    // an unsigned block is never certified, however many votes it has
+    if (!SIGNATURE_BIT(results, count))
+        return 0;
+
+    return valid - 1 >= threshold;
+}
@@ -0,0 +1,42 @@
+#ifndef QUORUM_H
+#define QUORUM_H
+
+#include <stddef.h>
+
+#include "block.h"
+
+// validators with a registered public key, one bitmap bit each
+#define MAX_VALIDATORS 64
+#define VALIDATOR_KEY_DIR "keys"
+
+// bytes of a voter bitmap and the bit of one validator slot
+#define VOTER_BITMAP_SIZE ((MAX_VALIDATORS + 7) / 8)
+#define VOTER_BIT(bitmap, slot) (((bitmap)[(slot) / 8] >> ((slot) % 8)) & 1)
+#define SET_VOTER_BIT(bitmap, slot) ((bitmap)[(slot) / 8] |= (unsigned char)(1 << ((slot) % 8)))
+
+// text every validator signs to approve a block
+#define VOTE_MESSAGE_SIZE 96
+
+// one signed approval
+typedef struct {
+    int validator_port;
+    char signature[HASH_SIZE];
+} QuorumVote;
+
+// approvals from distinct validators for one block hash
+typedef struct {
+    int index;
+    Digest block_hash;
+    int vote_count;
+    QuorumVote votes[MAX_VALIDATORS];
+} QuorumCertificate;
+
+void vote_message(int index, const Digest *block_hash, char out[VOTE_MESSAGE_SIZE]);
+int validator_slot(int port);
+int quorum_required();
+
+void quorum_init(QuorumCertificate *qc, int index, const Digest *block_hash);
+int quorum_add_vote(QuorumCertificate *qc, int validator_port, const char *signature);
+int quorum_verify(const QuorumCertificate *qc, const Block *block);
+
+#endif
@@ -0,0 +1,485 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "storage.h"
+#include "../crypto/hash.h"
+#include "../crypto/hex.h"
+
+// record layout (little endian), after a u32 length prefix:
+//   u8 version, [u8 block_version, v2 only], i32 index, i64 timestamp, i32 validator_port,
+//   hash previous_hash, hash block_hash, [hash merkle_root, block_version >= 3],
+//   sig validator_signature,
+//   u16 tx_count, then per transaction:
+//   str8 patient_id, str8 doctor_id, hash data_hash, str8 data_pointer, i64 timestamp
+//
+// hash: u8 kind; kind 0 = 32 raw digest bytes, kind 1 = u16 length + text ("0" = zero digest)
+// sig:  u8 kind; kind 0 = u16 length + raw bytes, kind 1 = u16 length + text
+// str8: u8 length + bytes
+//
+// quorum record, after a u32 length prefix:
+//   u8 version, i32 index, hash block_hash, u16 vote_count,
+//   then per vote: i32 validator_port, sig signature
+
+#define FIELD_BINARY 0
+#define FIELD_TEXT   1
+
+typedef struct {
+    unsigned char *data;
+    size_t capacity;
+    size_t len;
+    int overflow;
+} RecordWriter;
+
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    size_t pos;
+    int error;
+} RecordReader;
+
+static void put_bytes(RecordWriter *w, const void *src, size_t n)
+{
+    if (w->overflow || w->len + n > w->capacity)
+    {
+        w->overflow = 1;
+        return;
+    }
+
+    memcpy(w->data + w->len, src, n);
+    w->len += n;
+}
+
+static void put_u8(RecordWriter *w, uint8_t v)
+{
+    put_bytes(w, &v, 1);
+}
+
+static void put_u16(RecordWriter *w, uint16_t v)
+{
+    unsigned char b[2] = { v & 0xff, v >> 8 };
+    put_bytes(w, b, 2);
+}
+
+static void put_u32(RecordWriter *w, uint32_t v)
+{
+    unsigned char b[4];
+    for (int i = 0; i < 4; i++)
+        b[i] = (v >> (8 * i)) & 0xff;
+    put_bytes(w, b, 4);
+}
+
+static void put_u64(RecordWriter *w, uint64_t v)
+{
+    unsigned char b[8];
+    for (int i = 0; i < 8; i++)
+        b[i] = (v >> (8 * i)) & 0xff;
+    put_bytes(w, b, 8);
+}
+
+static const unsigned char *get_bytes(RecordReader *r, size_t n)
+{
+    if (r->error || r->pos + n > r->len)
+    {
+        r->error = 1;
+        return NULL;
+    }
+
+    const unsigned char *p = r->data + r->pos;
+    r->pos += n;
+    return p;
+}
+
+static uint8_t get_u8(RecordReader *r)
+{
+    const unsigned char *p = get_bytes(r, 1);
+    return p ? p[0] : 0;
+}
+
+static uint16_t get_u16(RecordReader *r)
+{
+    const unsigned char *p = get_bytes(r, 2);
+    return p ? (uint16_t)(p[0] | (p[1] << 8)) : 0;
+}
+
+static uint32_t get_u32(RecordReader *r)
+{
+    const unsigned char *p = get_bytes(r, 4);
+    uint32_t v = 0;
+
+    if (p)
+        for (int i = 0; i < 4; i++)
+            v |= (uint32_t)p[i] << (8 * i);
+
+    return v;
+}
+
+static uint64_t get_u64(RecordReader *r)
+{
+    const unsigned char *p = get_bytes(r, 8);
+    uint64_t v = 0;
+
+    if (p)
+        for (int i = 0; i < 8; i++)
+            v |= (uint64_t)p[i] << (8 * i);
+
+    return v;
+}
+
+// lowercase hex of even length round-trips through raw bytes
+static int is_canonical_hex(const char *text, size_t len)
+{
+    if (len % 2 != 0)
+        return 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = text[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return 0;
+    }
+
+    return 1;
+}
+
+static void put_hex_as_bytes(RecordWriter *w, const char *hex, size_t len)
+{
+    unsigned char bin[HASH_SIZE / 2];
+
+    if (len / 2 > sizeof(bin) || hex_decode(hex, bin, sizeof(bin)) != len / 2)
+    {
+        w->overflow = 1;
+        return;
+    }
+
+    put_bytes(w, bin, len / 2);
+}
+
+static void put_text16(RecordWriter *w, const char *text, size_t len)
+{
+    put_u16(w, (uint16_t)len);
+    put_bytes(w, text, len);
+}
+
+static void put_hash(RecordWriter *w, const Digest *hash)
+{
+    // the genesis previous hash keeps its historical text form "0"
+    if (digest_is_zero(hash))
+    {
+        put_u8(w, FIELD_TEXT);
+        put_text16(w, "0", 1);
+        return;
+    }
+
+    put_u8(w, FIELD_BINARY);
+    put_bytes(w, hash->bytes, DIGEST_SIZE);
+}
+
+static void put_signature(RecordWriter *w, const char *signature, size_t field_size)
+{
+    size_t len = strnlen(signature, field_size - 1);
+
+    if (is_canonical_hex(signature, len))
+    {
+        put_u8(w, FIELD_BINARY);
+        put_u16(w, (uint16_t)(len / 2));
+        put_hex_as_bytes(w, signature, len);
+        return;
+    }
+
+    put_u8(w, FIELD_TEXT);
+    put_text16(w, signature, len);
+}
+
+static void put_str8(RecordWriter *w, const char *text, size_t field_size)
+{
+    size_t len = strnlen(text, field_size - 1);
+
+    put_u8(w, (uint8_t)len);
+    put_bytes(w, text, len);
+}
+
+static void get_text(RecordReader *r, size_t len, char *out, size_t out_size)
+{
+    const unsigned char *p = get_bytes(r, len);
+
+    if (!p || len >= out_size)
+    {
+        r->error = 1;
+        return;
+    }
+
+    memcpy(out, p, len);
+    out[len] = '\0';
+}
+
+static void get_hash(RecordReader *r, Digest *out)
+{
+    uint8_t kind = get_u8(r);
+
+    if (kind == FIELD_BINARY)
+    {
+        const unsigned char *p = get_bytes(r, DIGEST_SIZE);
+        if (p)
+            memcpy(out->bytes, p, DIGEST_SIZE);
+    }
+    else if (kind == FIELD_TEXT)
+    {
+        char text[DIGEST_HEX_SIZE];
+
+        get_text(r, get_u16(r), text, sizeof(text));
+
+        if (!r->error && !digest_parse(text, out))
+            r->error = 1;
+    }
+    else
+    {
+        r->error = 1;
+    }
+}
+
+static void get_signature(RecordReader *r, char *out, size_t out_size)
+{
+    uint8_t kind = get_u8(r);
+    uint16_t len = get_u16(r);
+
+    if (kind == FIELD_BINARY)
+    {
+        const unsigned char *p = get_bytes(r, len);
+
+        if (p && (size_t)len * 2 < out_size)
+            hex_encode(p, len, out);
+        else
+            r->error = 1;
+    }
+    else if (kind == FIELD_TEXT)
+    {
+        get_text(r, len, out, out_size);
+    }
+    else
+    {
+        r->error = 1;
+    }
+}
+
+static void get_str8(RecordReader *r, char *out, size_t out_size)
+{
+    get_text(r, get_u8(r), out, out_size);
+}
+
+// chain file header
+void write_chain_header(unsigned char header[CHAIN_HEADER_SIZE])
+{
+    memset(header, 0, CHAIN_HEADER_SIZE);
+    memcpy(header, CHAIN_FILE_MAGIC, 8);
+    header[8] = CHAIN_FORMAT_VERSION;
+}
+
+int check_chain_header(const unsigned char *buffer, size_t len)
+{
+    return len >= CHAIN_HEADER_SIZE &&
+           memcmp(buffer, CHAIN_FILE_MAGIC, 8) == 0 &&
+           buffer[8] == CHAIN_FORMAT_VERSION;
+}
+
+// buffer size that always fits the encoded block
+size_t block_record_bound(const Block *block)
+{
+    return BLOCK_RECORD_FIXED + (size_t)block->transaction_count * BLOCK_RECORD_TX_MAX;
+}
+
+// encode a block; returns bytes written including the length prefix, 0 if it does not fit
+size_t encode_block_record(const Block *block, unsigned char *buffer, size_t capacity)
+{
+    RecordWriter w = { buffer, capacity, 0, 0 };
+
+    if (block->transaction_count < 0 ||
+        block->transaction_count > MAX_TRANSACTIONS ||
+        !block_version_supported(block->version))
+        return 0;
+
+    put_u32(&w, 0);   // patched below
+
+    // legacy blocks keep the v1 layout so old files re-encode byte for byte
+    if (block->version == BLOCK_VERSION_LEGACY)
+    {
+        put_u8(&w, BLOCK_RECORD_VERSION_LEGACY);
+    }
+    else
+    {
+        put_u8(&w, BLOCK_RECORD_VERSION);
+        put_u8(&w, (uint8_t)block->version);
+    }
+
+    put_u32(&w, (uint32_t)block->index);
+    put_u64(&w, (uint64_t)block->timestamp);
+    put_u32(&w, (uint32_t)block->validator_port);
+    put_hash(&w, &block->previous_hash);
+    put_hash(&w, &block->block_hash);
+
+    if (block->version >= BLOCK_VERSION_MERKLE)
+        put_hash(&w, &block->merkle_root);
+
+    put_signature(&w, block->validator_signature, sizeof(block->validator_signature));
+    put_u16(&w, (uint16_t)block->transaction_count);
+
+    for (int i = 0; i < block->transaction_count; i++)
+    {
+        const Transaction *tx = &block->transactions[i];
+
+        put_str8(&w, tx->patient_id, sizeof(tx->patient_id));
+        put_str8(&w, tx->doctor_id, sizeof(tx->doctor_id));
+        put_hash(&w, &tx->data_hash);
+        put_str8(&w, tx->data_pointer, sizeof(tx->data_pointer));
+        put_u64(&w, (uint64_t)tx->timestamp);
+    }
+
+    if (w.overflow)
+        return 0;
+
+    uint32_t body = (uint32_t)(w.len - 4);
+    for (int i = 0; i < 4; i++)
+        buffer[i] = (body >> (8 * i)) & 0xff;
+
+    return w.len;
+}
+
+// decode one record from the front of buffer; len is the bytes available
+int decode_block_record(const unsigned char *buffer, size_t len,
+                        Block *block, size_t *record_len)
+{
+    RecordReader r = { buffer, len, 0, 0 };
+
+    uint32_t body = get_u32(&r);
+    if (r.error || body > BLOCK_RECORD_MAX || 4 + (size_t)body > len)
+        return 0;
+
+    // never read past this record
+    r.len = 4 + (size_t)body;
+
+    uint8_t record_version = get_u8(&r);
+
+    memset(block, 0, sizeof(Block));
+
+    if (record_version == BLOCK_RECORD_VERSION_LEGACY)
+        block->version = BLOCK_VERSION_LEGACY;
+    else if (record_version == BLOCK_RECORD_VERSION)
+        block->version = get_u8(&r);
+    else
+        return 0;
+
+    if (!block_version_supported(block->version))
+        return 0;
+
+    block->index = (int32_t)get_u32(&r);
+    block->timestamp = (time_t)(int64_t)get_u64(&r);
+    block->validator_port = (int32_t)get_u32(&r);
+    get_hash(&r, &block->previous_hash);
+    get_hash(&r, &block->block_hash);
+
+    if (block->version >= BLOCK_VERSION_MERKLE)
+        get_hash(&r, &block->merkle_root);
+
+    get_signature(&r, block->validator_signature, sizeof(block->validator_signature));
+    int count = get_u16(&r);
+
+    // each transaction takes at least 12 bytes, so a short record cannot claim many
+    if (r.error || count > MAX_TRANSACTIONS || (size_t)count * 12 > r.len - r.pos ||
+        !reserve_transactions(block, count))
+    {
+        free_block(block);
+        return 0;
+    }
+
+    block->transaction_count = count;
+
+    for (int i = 0; i < count && !r.error; i++)
+    {
+        Transaction *tx = &block->transactions[i];
+
+        get_str8(&r, tx->patient_id, sizeof(tx->patient_id));
+        get_str8(&r, tx->doctor_id, sizeof(tx->doctor_id));
+        get_hash(&r, &tx->data_hash);
+        get_str8(&r, tx->data_pointer, sizeof(tx->data_pointer));
+        tx->timestamp = (time_t)(int64_t)get_u64(&r);
+    }
+
+    if (r.error || r.pos != r.len)
+    {
+        free_block(block);
+        return 0;
+    }
+
+    if (record_len)
+        *record_len = r.len;
+
+    return 1;
+}
+
+// encode a quorum certificate; returns 0 if it does not fit
+size_t encode_quorum_record(const QuorumCertificate *qc, unsigned char *buffer, size_t capacity)
+{
+    RecordWriter w = { buffer, capacity, 0, 0 };
+
+    if (qc->vote_count < 0 || qc->vote_count > MAX_VALIDATORS)
+        return 0;
+
+    put_u32(&w, 0);   // patched below
+    put_u8(&w, QUORUM_RECORD_VERSION);
+    put_u32(&w, (uint32_t)qc->index);
+    put_hash(&w, &qc->block_hash);
+    put_u16(&w, (uint16_t)qc->vote_count);
+
+    for (int i = 0; i < qc->vote_count; i++)
+    {
+        put_u32(&w, (uint32_t)qc->votes[i].validator_port);
+        put_signature(&w, qc->votes[i].signature, sizeof(qc->votes[i].signature));
+    }
+
+    if (w.overflow)
+        return 0;
+
+    uint32_t body = (uint32_t)(w.len - 4);
+    for (int i = 0; i < 4; i++)
+        buffer[i] = (body >> (8 * i)) & 0xff;
+
+    return w.len;
+}
+
+// decode one quorum record from the front of buffer
+int decode_quorum_record(const unsigned char *buffer, size_t len,
+                         QuorumCertificate *qc, size_t *record_len)
+{
+    RecordReader r = { buffer, len, 0, 0 };
+
+    uint32_t body = get_u32(&r);
+    if (r.error || body > QUORUM_RECORD_MAX || 4 + (size_t)body > len)
+        return 0;
+
+    r.len = 4 + (size_t)body;
+
+    if (get_u8(&r) != QUORUM_RECORD_VERSION)
+        return 0;
+
+    qc->index = (int32_t)get_u32(&r);
+    get_hash(&r, &qc->block_hash);
+    qc->vote_count = get_u16(&r);
+
+    if (r.error || qc->vote_count > MAX_VALIDATORS)
+        return 0;
+
+    for (int i = 0; i < qc->vote_count && !r.error; i++)
+    {
+        qc->votes[i].validator_port = (int32_t)get_u32(&r);
+        get_signature(&r, qc->votes[i].signature, sizeof(qc->votes[i].signature));
+    }
+
+    if (r.error || r.pos != r.len)
+        return 0;
+
+    if (record_len)
+        *record_len = r.len;
+
+    return 1;
+}
@@ -0,0 +1,41 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stddef.h>
+
+#include "block.h"
+#include "quorum.h"
+
+// chain file header: magic + format version
+#define CHAIN_FILE_MAGIC "MRBCHAIN"
+#define CHAIN_FORMAT_VERSION 1
+#define CHAIN_HEADER_SIZE 16
+
+// record layout versions; v2 adds the block version, v1 records hold legacy blocks
+#define BLOCK_RECORD_VERSION_LEGACY 1
+#define BLOCK_RECORD_VERSION 2
+
+// encoded size bounds: fixed fields, then the largest transaction
+#define BLOCK_RECORD_FIXED (4 + 2 + 4 + 8 + 4 + 3 * (3 + DIGEST_HEX_SIZE) + 3 + HASH_SIZE + 2)
+#define BLOCK_RECORD_TX_MAX (32 + 32 + (3 + DIGEST_HEX_SIZE) + 128 + 8)
+
+// upper bound of one encoded record
+#define BLOCK_RECORD_MAX (BLOCK_RECORD_FIXED + MAX_TRANSACTIONS * BLOCK_RECORD_TX_MAX)
+
+// quorum certificate sidecar records
+#define QUORUM_RECORD_VERSION 1
+#define QUORUM_RECORD_MAX (4 + 1 + 4 + (3 + DIGEST_HEX_SIZE) + 2 + MAX_VALIDATORS * (4 + 3 + HASH_SIZE))
+
+void write_chain_header(unsigned char header[CHAIN_HEADER_SIZE]);
+int check_chain_header(const unsigned char *buffer, size_t len);
+
+size_t block_record_bound(const Block *block);
+size_t encode_block_record(const Block *block, unsigned char *buffer, size_t capacity);
+int decode_block_record(const unsigned char *buffer, size_t len,
+                        Block *block, size_t *record_len);
+
+size_t encode_quorum_record(const QuorumCertificate *qc, unsigned char *buffer, size_t capacity);
+int decode_quorum_record(const unsigned char *buffer, size_t len,
+                         QuorumCertificate *qc, size_t *record_len);
+
+#endif
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "verifier.h"
+#include "chain_view.h"
+#include "../crypto/signature.h"
+
+// blocks claimed by a worker at a time
+#define VERIFY_CHUNK 64
+
+enum {
+    FAIL_NONE = 0,
+    FAIL_READ,
+    FAIL_HASH,
+    FAIL_SIGNATURE,
+    FAIL_LINK
+};
+
+typedef struct {
+    ChainView *view;
+    int count;
+
+    pthread_mutex_t lock;
+    int next_chunk;
+    int first_failure;        // lowest failing position seen so far
+    int failure_kind;
+    int failure_block;
+    int out_of_memory;        // a worker could not allocate its window
+} AuditState;
+
+// per-worker scratch space for one chunk
+typedef struct {
+    Block blocks[VERIFY_CHUNK];
+    Digest hashes[VERIFY_CHUNK];
+    char hash_hex[VERIFY_CHUNK][DIGEST_HEX_SIZE];
+    char public_key_paths[VERIFY_CHUNK][64];
+    SignatureCheck checks[VERIFY_CHUNK];
+    unsigned char results[SIGNATURE_BITMAP_SIZE(VERIFY_CHUNK)];
+} AuditWindow;
+
+// keep only the lowest failing position
+static void record_failure(AuditState *state, int position, int kind, int block_index)
+{
+    pthread_mutex_lock(&state->lock);
+
+    if (state->first_failure == -1 || position < state->first_failure)
+    {
+        state->first_failure = position;
+        state->failure_kind = kind;
+        state->failure_block = block_index;
+    }
+
+    pthread_mutex_unlock(&state->lock);
+}
+
+// claim the next chunk, or -1 once past the end, past a known failure or out of memory
+static int claim_chunk(AuditState *state)
+{
+    pthread_mutex_lock(&state->lock);
+
+    int start = state->next_chunk;
+
+    if (start >= state->count || state->out_of_memory ||
+        (state->first_failure != -1 && start > state->first_failure))
+        start = -1;
+    else
+        state->next_chunk += VERIFY_CHUNK;
+
+    pthread_mutex_unlock(&state->lock);
+
+    return start;
+}
+
+// check links, hashes and signatures of one chunk; the link into the chunk
+// comes from the stored hash of the block before it
+static void audit_chunk(AuditState *state, AuditWindow *aw, int start)
+{
+    int end = start + VERIFY_CHUNK;
+    if (end > state->count)
+        end = state->count;
+
+    Digest prev_hash;
+    memset(&prev_hash, 0, sizeof(prev_hash));
+
+    if (start > 0)
+    {
+        Block before;
+
+        if (!chain_view_block(state->view, start - 1, &before))
+        {
+            record_failure(state, start - 1, FAIL_READ, start - 1);
+            return;
+        }
+
+        prev_hash = before.block_hash;
+        free_block(&before);
+    }
+
+    int n = 0;
+
+    for (int i = start; i < end; i++)
+    {
+        Block *curr = &aw->blocks[n];
+
+        if (!chain_view_block(state->view, i, curr))
+        {
+            record_failure(state, i, FAIL_READ, i);
+            break;
+        }
+
+        if (i > 0 && !digest_equal(&curr->previous_hash, &prev_hash))
+        {
+            record_failure(state, i, FAIL_LINK, curr->index);
+            free_block(curr);
+            break;
+        }
+
+        prev_hash = curr->block_hash;
+        n++;
+    }
+
+    calculate_block_hashes(aw->blocks, n, aw->hashes);
+
+    int signed_count = n;
+
+    for (int k = 0; k < n; k++)
+    {
+        if (!digest_equal(&aw->hashes[k], &aw->blocks[k].block_hash) ||
+            !block_merkle_valid(&aw->blocks[k]))
+        {
+            record_failure(state, start + k, FAIL_HASH, aw->blocks[k].index);
+            signed_count = k;
+            break;
+        }
+    }
+
+    // only blocks before the first bad hash need their signatures checked
+    for (int k = 0; k < signed_count; k++)
+    {
+        snprintf(aw->public_key_paths[k], sizeof(aw->public_key_paths[k]),
+                 "keys/%d_public.pem", aw->blocks[k].validator_port);
+
+        digest_to_hex(&aw->blocks[k].block_hash, aw->hash_hex[k]);
+
+        aw->checks[k].data = aw->hash_hex[k];
+        aw->checks[k].public_key_path = aw->public_key_paths[k];
+        aw->checks[k].signature_hex = aw->blocks[k].validator_signature;
+    }
+
+    if (signed_count > 0 &&
+        verify_signatures_batch(aw->checks, signed_count, aw->results) != signed_count)
+    {
+        for (int k = 0; k < signed_count; k++)
+        {
+            if (!SIGNATURE_BIT(aw->results, k))
+            {
+                record_failure(state, start + k, FAIL_SIGNATURE, aw->blocks[k].index);
+                break;
+            }
+        }
+    }
+
+    for (int k = 0; k < n; k++)
+        free_block(&aw->blocks[k]);
+}
+
+static void *audit_worker(void *arg)
+{
+    AuditState *state = arg;
+    AuditWindow *aw = malloc(sizeof(AuditWindow));
+    int start;
+
+    if (!aw)
+    {
+        pthread_mutex_lock(&state->lock);
+        state->out_of_memory = 1;
+        pthread_mutex_unlock(&state->lock);
+        return NULL;
+    }
+
+    while ((start = claim_chunk(state)) != -1)
+        audit_chunk(state, aw, start);
+
+    free(aw);
+
+    return NULL;
+}
+
+// verify every block of a chain file on a pool of worker threads
+int audit_chain_parallel(const char *chain_file, int threads, ChainAudit *audit)
+{
+    memset(audit, 0, sizeof(*audit));
+    audit->failed_position = -1;
+
+    ChainView view;
+    if (!chain_view_open(&view, chain_file))
+        return 0;
+
+    if (view.count == 0)
+    {
+        chain_view_close(&view);
+        return 0;
+    }
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > VERIFY_MAX_THREADS)
+        threads = VERIFY_MAX_THREADS;
+
+    AuditState state;
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_init(&state.lock, NULL);
+    state.view = &view;
+    state.count = view.count;
+    state.first_failure = -1;
+
+    pthread_t workers[VERIFY_MAX_THREADS];
+    int started = 0;
+
+    for (int i = 0; i < threads - 1; i++)
+    {
+        if (pthread_create(&workers[started], NULL, audit_worker, &state) == 0)
+            started++;
+    }
+
+    // the calling thread works too
+    audit_worker(&state);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    audit->height = state.count;
+    audit->failed_position = state.first_failure;
+
+    // chunks left unchecked must not pass for a valid chain
+    if (state.out_of_memory && state.first_failure == -1)
+    {
+        printf("[BLOCKCHAIN] Out of memory while auditing the chain.\n");
+        pthread_mutex_destroy(&state.lock);
+        chain_view_close(&view);
+        return 0;
+    }
+
+    switch (state.failure_kind)
+    {
+    case FAIL_READ:
+        printf("[STORAGE] Failed to read stored block %d.\n", state.failure_block);
+        break;
+    case FAIL_HASH:
+        if (state.first_failure == 0)
+            printf("[BLOCKCHAIN] Genesis hash validation failed.\n");
+        else
+            printf("[BLOCKCHAIN] Hash validation failed at block %d.\n",
+                   state.failure_block);
+        break;
+    case FAIL_SIGNATURE:
+        if (state.first_failure == 0)
+            printf("[CRYPTO] Genesis signature validation failed.\n");
+        else
+            printf("[CRYPTO] Signature validation failed at block %d.\n",
+                   state.failure_block);
+        break;
+    case FAIL_LINK:
+        printf("[BLOCKCHAIN] Previous hash mismatch at block %d.\n",
+               state.failure_block);
+        break;
+    }
+
+    Block tip;
+    if (state.first_failure == -1 &&
+        chain_view_block(&view, state.count - 1, &tip))
+    {
+        audit->tip_hash = tip.block_hash;
+        free_block(&tip);
+    }
+
+    pthread_mutex_destroy(&state.lock);
+    chain_view_close(&view);
+
+    return state.first_failure == -1;
+}
@@ -0,0 +1,17 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "block.h"
+
+#define VERIFY_MAX_THREADS 64
+
+// outcome of a full-chain audit over a snapshot of the chain file
+typedef struct {
+    int height;                   // blocks in the snapshot
+    int failed_position;          // first failing position, -1 if none
+    Digest tip_hash;              // hash of the last block when valid
+} ChainAudit;
+
+int audit_chain_parallel(const char *chain_file, int threads, ChainAudit *audit);
+
+#endif
@@ -11,26 +11,33 @@ int main() {
     printf("Genesis block created.\n");
 
     Block block;
+    memset(&block, 0, sizeof(Block));
     block.index = 1;
     block.timestamp = time(NULL);
-    strcpy(block.previous_hash, genesis.block_hash);
+    block.previous_hash = genesis.block_hash;
 
     Transaction tx;
     strcpy(tx.patient_id, "PATIENT123");
     strcpy(tx.doctor_id, "DOCTOR01");
     strcpy(tx.data_pointer, "file://offchain/storage/record1.enc");
-    sha256("encrypted_record_content", tx.data_hash);
+    const char *content = "encrypted_record_content";
+    sha256_digest(content, strlen(content), tx.data_hash.bytes);
     tx.timestamp = time(NULL);
 
-    block.transactions[0] = tx;
-    block.transaction_count = 1;
+    add_transaction(&block, &tx);
+
+    char hex[DIGEST_HEX_SIZE];
+    digest_to_hex(&tx.data_hash, hex);
 
     char data_to_hash[256];
-    snprintf(data_to_hash, sizeof(data_to_hash), "%d%s", block.index, tx.data_hash);
-    sha256(data_to_hash, block.block_hash);
+    snprintf(data_to_hash, sizeof(data_to_hash), "%d%s", block.index, hex);
+    sha256_digest(data_to_hash, strlen(data_to_hash), block.block_hash.bytes);
 
-    sign_data(block.block_hash, "hospital_private_key", block.validator_signature);
+    digest_to_hex(&block.block_hash, hex);
+    sign_data(hex, "hospital_private_key", block.validator_signature);
     add_block(&block);
+    free_block(&block);
+    free_block(&genesis);
 
     printf("Block added.\n");
 
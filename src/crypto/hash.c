@@ -2,8 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "hash.h"
+#include "hex.h"
+#include "sha256_accel.h"
+
+// read size used by sha256_file
+#define SHA256_FILE_CHUNK (256 * 1024)
 
 #define ROTRIGHT(a,b) (((a) >> (b)) | ((a) << (32-(b))))
 #define CH(x,y,z) (((x) & (y)) ^ (~(x) & (z)))
@@ -13,7 +22,7 @@
 #define SIG0(x) (ROTRIGHT(x,7) ^ ROTRIGHT(x,18) ^ ((x) >> 3))
 #define SIG1(x) (ROTRIGHT(x,17) ^ ROTRIGHT(x,19) ^ ((x) >> 10))
 
-static const uint32_t k[64] = {
+const uint32_t sha256_round_constants[64] = {
     0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,
     0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
     0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,
@@ -32,36 +41,25 @@ static const uint32_t k[64] = {
     0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 };
 
-void sha256(const char *input, char *output)
-{
-    uint32_t h[8] = {
-        0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,
-        0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
-    };
-
-    size_t len = strlen(input);
-    size_t new_len = len + 1;
-
-    while (new_len % 64 != 56)
-        new_len++;
-
-    uint8_t *msg = calloc(new_len + 8, 1);
-    memcpy(msg, input, len);
-    msg[len] = 0x80;
+static const uint32_t sha256_initial_state[8] = {
+    0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,
+    0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+};
 
-    uint64_t bits_len = len * 8;
-    for (int i = 0; i < 8; i++)
-        msg[new_len + i] = (bits_len >> ((7 - i) * 8)) & 0xff;
+// reference compress function, used when the CPU has no SHA instructions
+void sha256_compress_portable(uint32_t h[8], const uint8_t *msg, size_t blocks)
+{
+    const uint32_t *k = sha256_round_constants;
 
-    for (size_t offset = 0; offset < new_len; offset += 64)
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
     {
         uint32_t w[64];
         for (int i = 0; i < 16; i++)
         {
-            w[i] = (msg[offset + i*4] << 24) |
-                   (msg[offset + i*4 + 1] << 16) |
-                   (msg[offset + i*4 + 2] << 8) |
-                   (msg[offset + i*4 + 3]);
+            w[i] = ((uint32_t)msg[offset + i*4] << 24) |
+                   ((uint32_t)msg[offset + i*4 + 1] << 16) |
+                   ((uint32_t)msg[offset + i*4 + 2] << 8) |
+                   ((uint32_t)msg[offset + i*4 + 3]);
         }
 
         for (int i = 16; i < 64; i++)
@@ -99,11 +97,221 @@ void sha256(const char *input, char *output)
         h[6] += g;
         h[7] += hh;
     }
+}
+
+// backend chosen once per process
+static pthread_once_t backend_once = PTHREAD_ONCE_INIT;
+static Sha256CompressFn accelerated_compress = NULL;
+static const char *accelerated_name = NULL;
+static Sha256CompressFn sha256_compress = sha256_compress_portable;
+
+static void select_backend(void)
+{
+    accelerated_compress = sha256_detect_accelerated(&accelerated_name);
+
+    if (accelerated_compress)
+        sha256_compress = accelerated_compress;
+}
+
+// switch between the hardware and portable backends; returns 1 if hardware is active
+int sha256_set_accelerated(int enabled)
+{
+    pthread_once(&backend_once, select_backend);
+
+    sha256_compress = (enabled && accelerated_compress)
+        ? accelerated_compress
+        : sha256_compress_portable;
+
+    return sha256_compress != sha256_compress_portable;
+}
+
+const char *sha256_backend_name(void)
+{
+    pthread_once(&backend_once, select_backend);
+
+    return sha256_compress == sha256_compress_portable
+        ? "portable"
+        : accelerated_name;
+}
+
+void sha256_init(Sha256Ctx *ctx)
+{
+    pthread_once(&backend_once, select_backend);
+
+    memcpy(ctx->state, sha256_initial_state, sizeof(ctx->state));
+    ctx->length = 0;
+    ctx->buffer_len = 0;
+}
+
+// feed bytes; whole blocks are compressed in place, partial ones are buffered
+void sha256_update(Sha256Ctx *ctx, const void *data, size_t len)
+{
+    const uint8_t *msg = data;
+
+    ctx->length += len;
+
+    if (ctx->buffer_len > 0)
+    {
+        size_t take = 64 - ctx->buffer_len;
+        if (take > len)
+            take = len;
+
+        memcpy(ctx->buffer + ctx->buffer_len, msg, take);
+        ctx->buffer_len += take;
+        msg += take;
+        len -= take;
+
+        if (ctx->buffer_len < 64)
+            return;
+
+        sha256_compress(ctx->state, ctx->buffer, 1);
+        ctx->buffer_len = 0;
+    }
+
+    size_t full_blocks = len / 64;
+
+    if (full_blocks > 0)
+        sha256_compress(ctx->state, msg, full_blocks);
 
-    free(msg);
+    size_t rest = len - full_blocks * 64;
+
+    memcpy(ctx->buffer, msg + full_blocks * 64, rest);
+    ctx->buffer_len = rest;
+}
+
+void sha256_final(Sha256Ctx *ctx, unsigned char digest[DIGEST_SIZE])
+{
+    uint8_t tail[128];
+    size_t rest = ctx->buffer_len;
+    size_t tail_len = rest < 56 ? 64 : 128;
+
+    memset(tail, 0, tail_len);
+    memcpy(tail, ctx->buffer, rest);
+    tail[rest] = 0x80;
+
+    uint64_t bits_len = ctx->length * 8;
+    for (int i = 0; i < 8; i++)
+        tail[tail_len - 8 + i] = (bits_len >> ((7 - i) * 8)) & 0xff;
+
+    sha256_compress(ctx->state, tail, tail_len / 64);
 
     for (int i = 0; i < 8; i++)
-        sprintf(output + (i * 8), "%08x", h[i]);
+    {
+        digest[i*4] = (ctx->state[i] >> 24) & 0xff;
+        digest[i*4 + 1] = (ctx->state[i] >> 16) & 0xff;
+        digest[i*4 + 2] = (ctx->state[i] >> 8) & 0xff;
+        digest[i*4 + 3] = ctx->state[i] & 0xff;
+    }
+}
+
+// hash a byte range in one call
+void sha256_digest(const void *data, size_t len, unsigned char digest[DIGEST_SIZE])
+{
+    Sha256Ctx ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
+
+void sha256(const char *input, char output[65])
+{
+    unsigned char digest[DIGEST_SIZE];
+
+    sha256_digest(input, strlen(input), digest);
+    hex_encode(digest, DIGEST_SIZE, output);
+}
+
+// hash a file of any size in fixed-size chunks
+int sha256_file(const char *path, Digest *digest)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    unsigned char *chunk = malloc(SHA256_FILE_CHUNK);
+    if (!chunk)
+    {
+        close(fd);
+        return 0;
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    Sha256Ctx ctx;
+    sha256_init(&ctx);
+
+    int ok = 1;
+
+    while (1)
+    {
+        ssize_t n = read(fd, chunk, SHA256_FILE_CHUNK);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0)
+        {
+            ok = 0;
+            break;
+        }
+
+        if (n == 0)
+            break;
+
+        sha256_update(&ctx, chunk, (size_t)n);
+    }
+
+    free(chunk);
+    close(fd);
+
+    if (!ok)
+        return 0;
+
+    sha256_final(&ctx, digest->bytes);
+
+    return 1;
+}
+
+// parse a 64-character hex digest into raw bytes
+int digest_from_hex(const char *hex, unsigned char digest[DIGEST_SIZE])
+{
+    return strlen(hex) == 2 * DIGEST_SIZE &&
+           hex_decode(hex, digest, DIGEST_SIZE) == DIGEST_SIZE;
+}
+
+// hex form of a digest; the zero digest is the genesis parent "0"
+void digest_to_hex(const Digest *digest, char hex[DIGEST_HEX_SIZE])
+{
+    if (digest_is_zero(digest))
+    {
+        strcpy(hex, "0");
+        return;
+    }
+
+    hex_encode(digest->bytes, DIGEST_SIZE, hex);
+}
+
+// inverse of digest_to_hex; "0" and "" parse as the zero digest
+int digest_parse(const char *hex, Digest *digest)
+{
+    if (hex[0] == '\0' || strcmp(hex, "0") == 0)
+    {
+        memset(digest->bytes, 0, DIGEST_SIZE);
+        return 1;
+    }
+
+    return digest_from_hex(hex, digest->bytes);
+}
+
+int digest_equal(const Digest *a, const Digest *b)
+{
+    return memcmp(a->bytes, b->bytes, DIGEST_SIZE) == 0;
+}
+
+int digest_is_zero(const Digest *digest)
+{
+    static const Digest zero;
 
-    output[64] = '\0';
+    return memcmp(digest->bytes, zero.bytes, DIGEST_SIZE) == 0;
 }
@@ -1,6 +1,49 @@
 #ifndef HASH_H
 #define HASH_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIGEST_SIZE 32
+#define DIGEST_HEX_SIZE 65
+
+// raw SHA-256 value; hex only at display and wire edges
+typedef struct {
+    unsigned char bytes[DIGEST_SIZE];
+} Digest;
+
+// incremental SHA-256 state
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char buffer[64];
+    size_t buffer_len;
+} Sha256Ctx;
+
+void sha256_init(Sha256Ctx *ctx);
+void sha256_update(Sha256Ctx *ctx, const void *data, size_t len);
+void sha256_final(Sha256Ctx *ctx, unsigned char digest[DIGEST_SIZE]);
+
 void sha256(const char *input, char output[65]);
+void sha256_digest(const void *data, size_t len, unsigned char digest[DIGEST_SIZE]);
+int sha256_file(const char *path, Digest *digest);
+// several independent messages at once on SIMD lanes (AVX-512, AVX2 or scalar)
+#define SHA256_MAX_LANES 16
+
+void sha256_digest_many(const void *const *data, const size_t *lens, int count,
+                        unsigned char (*digests)[DIGEST_SIZE]);
+int sha256_lane_count(void);
+const char *sha256_lanes_name(void);
+
+int digest_from_hex(const char *hex, unsigned char digest[DIGEST_SIZE]);
+void digest_to_hex(const Digest *digest, char hex[DIGEST_HEX_SIZE]);
+int digest_parse(const char *hex, Digest *digest);
+int digest_equal(const Digest *a, const Digest *b);
+int digest_is_zero(const Digest *digest);
+
+// backend selection; SHA-NI or ARMv8 is picked automatically when present.
+// switching is meant for benchmarks, before other threads start hashing
+int sha256_set_accelerated(int enabled);
+const char *sha256_backend_name(void);
 
 #endif
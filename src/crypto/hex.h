@@ -0,0 +1,12 @@
+#ifndef HEX_H
+#define HEX_H
+
+#include <stddef.h>
+
+// writes 2 * len characters plus a terminating NUL
+void hex_encode(const unsigned char *bin, size_t len, char *hex);
+
+// returns the number of bytes decoded, or 0 on odd length, bad digits or overflow
+size_t hex_decode(const char *hex, unsigned char *bin, size_t capacity);
+
+#endif
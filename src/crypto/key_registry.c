@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <openssl/pem.h>
+
+#include "key_registry.h"
+
+// one cached validator public key
+typedef struct {
+    char path[128];
+    EVP_PKEY *pkey;
+    EVP_MD_CTX *template_ctx;   // DigestVerifyInit already applied
+    pthread_mutex_t template_lock;
+
+    time_t mtime;
+    ino_t inode;
+    off_t size;
+    time_t checked_at;
+} ValidatorKey;
+
+static ValidatorKey keys[MAX_VALIDATOR_KEYS];
+static int key_count = 0;
+static pthread_rwlock_t registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static pthread_once_t ctx_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ctx_key;
+
+static void free_thread_context(void *ctx)
+{
+    EVP_MD_CTX_free(ctx);
+}
+
+static void create_context_key(void)
+{
+    pthread_key_create(&ctx_key, free_thread_context);
+}
+
+// per-thread verify context, reused across calls
+EVP_MD_CTX *thread_verify_context(void)
+{
+    pthread_once(&ctx_once, create_context_key);
+
+    EVP_MD_CTX *ctx = pthread_getspecific(ctx_key);
+    if (!ctx)
+    {
+        ctx = EVP_MD_CTX_new();
+        if (ctx)
+            pthread_setspecific(ctx_key, ctx);
+    }
+
+    return ctx;
+}
+
+static void release_key_locked(ValidatorKey *key)
+{
+    EVP_MD_CTX_free(key->template_ctx);
+    EVP_PKEY_free(key->pkey);
+
+    key->template_ctx = NULL;
+    key->pkey = NULL;
+}
+
+// parse the PEM file and build the reusable verify template
+static int load_key_locked(ValidatorKey *key, const struct stat *st)
+{
+    FILE *fp = fopen(key->path, "r");
+    if (!fp)
+    {
+        printf("[CRYPTO] Public key file not found: %s\n", key->path);
+        return 0;
+    }
+
+    EVP_PKEY *pkey = PEM_read_PUBKEY(fp, NULL, NULL, NULL);
+    fclose(fp);
+
+    if (!pkey)
+    {
+        printf("[CRYPTO] Failed to load public key.\n");
+        return 0;
+    }
+
+    EVP_MD_CTX *template_ctx = EVP_MD_CTX_new();
+
+    if (!template_ctx ||
+        EVP_DigestVerifyInit(template_ctx, NULL, EVP_sha256(), NULL, pkey) <= 0)
+    {
+        EVP_MD_CTX_free(template_ctx);
+        EVP_PKEY_free(pkey);
+        return 0;
+    }
+
+    release_key_locked(key);
+
+    key->pkey = pkey;
+    key->template_ctx = template_ctx;
+    key->mtime = st->st_mtime;
+    key->inode = st->st_ino;
+    key->size = st->st_size;
+    key->checked_at = time(NULL);
+
+    return 1;
+}
+
+static ValidatorKey *find_key_locked(const char *path)
+{
+    for (int i = 0; i < key_count; i++)
+    {
+        if (strcmp(keys[i].path, path) == 0)
+            return &keys[i];
+    }
+
+    return NULL;
+}
+
+// true if the cached key is loaded and recently confirmed current
+static int key_is_fresh(const ValidatorKey *key, time_t now)
+{
+    return key && key->pkey && now - key->checked_at < KEY_RECHECK_SECONDS;
+}
+
+// look up (loading or reloading as needed) the key for a path
+static ValidatorKey *acquire_key(const char *path)
+{
+    time_t now = time(NULL);
+
+    pthread_rwlock_rdlock(&registry_lock);
+    ValidatorKey *key = find_key_locked(path);
+    if (key_is_fresh(key, now))
+        return key;   // caller unlocks
+    pthread_rwlock_unlock(&registry_lock);
+
+    pthread_rwlock_wrlock(&registry_lock);
+
+    key = find_key_locked(path);
+
+    if (!key_is_fresh(key, now))
+    {
+        struct stat st;
+
+        if (stat(path, &st) != 0)
+        {
+            printf("[CRYPTO] Public key file not found: %s\n", path);
+            pthread_rwlock_unlock(&registry_lock);
+            return NULL;
+        }
+
+        if (!key)
+        {
+            if (key_count == MAX_VALIDATOR_KEYS || strlen(path) >= sizeof(keys[0].path))
+            {
+                pthread_rwlock_unlock(&registry_lock);
+                return NULL;
+            }
+
+            key = &keys[key_count++];
+            memset(key, 0, sizeof(*key));
+            strcpy(key->path, path);
+            pthread_mutex_init(&key->template_lock, NULL);
+        }
+
+        int changed = !key->pkey ||
+                      key->mtime != st.st_mtime ||
+                      key->inode != st.st_ino ||
+                      key->size != st.st_size;
+
+        if (changed)
+        {
+            if (key->pkey)
+                printf("[CRYPTO] Reloading changed key file %s\n", path);
+
+            if (!load_key_locked(key, &st))
+            {
+                pthread_rwlock_unlock(&registry_lock);
+                return NULL;
+            }
+        }
+
+        key->checked_at = now;
+    }
+
+    // hand back under a read lock like the fast path
+    pthread_rwlock_unlock(&registry_lock);
+    return acquire_key(path);
+}
+
+// set ctx up for DigestVerify with the cached key for this path
+int prepare_verify_context(const char *public_key_path, EVP_MD_CTX *ctx)
+{
+    ValidatorKey *key = acquire_key(public_key_path);
+    if (!key)
+        return 0;
+
+    // copying the template skips the provider fetch done by init
+    pthread_mutex_lock(&key->template_lock);
+    int ok = EVP_MD_CTX_copy_ex(ctx, key->template_ctx);
+    pthread_mutex_unlock(&key->template_lock);
+
+    if (!ok)
+        ok = EVP_DigestVerifyInit(ctx, NULL, EVP_sha256(), NULL, key->pkey) > 0;
+
+    pthread_rwlock_unlock(&registry_lock);
+
+    return ok;
+}
+
+// forget every cached key; they are reloaded on next use
+void reload_validator_keys(void)
+{
+    pthread_rwlock_wrlock(&registry_lock);
+
+    for (int i = 0; i < key_count; i++)
+    {
+        release_key_locked(&keys[i]);
+        pthread_mutex_destroy(&keys[i].template_lock);
+    }
+
+    key_count = 0;
+
+    pthread_rwlock_unlock(&registry_lock);
+}
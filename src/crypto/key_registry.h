@@ -0,0 +1,15 @@
+#ifndef KEY_REGISTRY_H
+#define KEY_REGISTRY_H
+
+#include <openssl/evp.h>
+
+#define MAX_VALIDATOR_KEYS 256
+
+// seconds between checks of a cached key file for changes
+#define KEY_RECHECK_SECONDS 2
+
+int prepare_verify_context(const char *public_key_path, EVP_MD_CTX *ctx);
+EVP_MD_CTX *thread_verify_context(void);
+void reload_validator_keys(void);
+
+#endif
@@ -0,0 +1,168 @@
+#include "sha256_accel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+// x86 SHA extensions, four rounds per pair of sha256rnds2
+__attribute__((target("sha,sse4.1")))
+static void compress_shani(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                             0x0405060700010203ULL);
+
+    // the instructions want the state as ABEF / CDGH
+    __m128i tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (blocks--)
+    {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+        __m128i m[4];
+
+        #pragma GCC unroll 16
+        for (int g = 0; g < 16; g++)
+        {
+            if (g < 4)
+                m[g] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i *)(data + 16 * g)), byte_swap);
+
+            __m128i msg = _mm_add_epi32(
+                m[g & 3],
+                _mm_loadu_si128((const __m128i *)&sha256_round_constants[4 * g]));
+
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+            if (g >= 3 && g <= 14)
+            {
+                __m128i next = _mm_add_epi32(
+                    m[(g + 1) & 3],
+                    _mm_alignr_epi8(m[g & 3], m[(g + 3) & 3], 4));
+                m[(g + 1) & 3] = _mm_sha256msg2_epu32(next, m[g & 3]);
+            }
+
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+            if (g >= 1 && g <= 12)
+                m[(g + 3) & 3] = _mm_sha256msg1_epu32(m[(g + 3) & 3], m[g & 3]);
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+// cpuid leaf 7 reports SHA in ebx bit 29; SSE4.1 is leaf 1 ecx bit 19
+static int cpu_has_shani(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+        return 0;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return 0;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    return (ebx & (1u << 29)) != 0;
+}
+
+Sha256CompressFn sha256_detect_accelerated(const char **name)
+{
+    if (cpu_has_shani())
+    {
+        *name = "x86 SHA-NI";
+        return compress_shani;
+    }
+
+    return NULL;
+}
+
+#elif defined(__aarch64__) && defined(__linux__)
+
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+// ARMv8 crypto extensions, four rounds per sha256h/sha256h2 pair
+__attribute__((target("+crypto")))
+static void compress_armv8(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    while (blocks--)
+    {
+        uint32x4_t abcd_save = state0;
+        uint32x4_t efgh_save = state1;
+        uint32x4_t m[4];
+
+        for (int i = 0; i < 4; i++)
+            m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+        #pragma GCC unroll 16
+        for (int g = 0; g < 16; g++)
+        {
+            uint32x4_t wk = vaddq_u32(m[g & 3],
+                                      vld1q_u32(&sha256_round_constants[4 * g]));
+
+            if (g < 12)
+                m[g & 3] = vsha256su0q_u32(m[g & 3], m[(g + 1) & 3]);
+
+            uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, abcd, wk);
+
+            if (g < 12)
+                m[g & 3] = vsha256su1q_u32(m[g & 3], m[(g + 2) & 3], m[(g + 3) & 3]);
+        }
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+
+        data += 64;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+Sha256CompressFn sha256_detect_accelerated(const char **name)
+{
+    if (getauxval(AT_HWCAP) & HWCAP_SHA2)
+    {
+        *name = "ARMv8 SHA2";
+        return compress_armv8;
+    }
+
+    return NULL;
+}
+
+#else
+
+Sha256CompressFn sha256_detect_accelerated(const char **name)
+{
+    (void)name;
+    return NULL;
+}
+
+#endif
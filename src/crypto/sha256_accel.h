@@ -0,0 +1,19 @@
+#ifndef SHA256_ACCEL_H
+#define SHA256_ACCEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// process whole 64-byte blocks into the running state
+typedef void (*Sha256CompressFn)(uint32_t state[8],
+                                 const uint8_t *data,
+                                 size_t blocks);
+
+extern const uint32_t sha256_round_constants[64];
+
+void sha256_compress_portable(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+// hardware compress function for this CPU, or NULL
+Sha256CompressFn sha256_detect_accelerated(const char **name);
+
+#endif
@@ -0,0 +1,379 @@
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "sha256_accel.h"
+
+// message words of one block per lane, already big-endian decoded: w[word][lane]
+typedef void (*Sha256LanesFn)(uint32_t state[8][SHA256_MAX_LANES],
+                              uint32_t w[16][SHA256_MAX_LANES]);
+
+static const uint32_t initial_state[8] = {
+    0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,
+    0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+};
+
+#define ROTR32(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// four lanes interleaved round by round; portable fallback
+static void compress_x4_scalar(uint32_t state[8][SHA256_MAX_LANES],
+                               uint32_t w[16][SHA256_MAX_LANES])
+{
+    uint32_t v[8][4];
+    uint32_t schedule[64][4];
+
+    for (int i = 0; i < 16; i++)
+        for (int l = 0; l < 4; l++)
+            schedule[i][l] = w[i][l];
+
+    for (int i = 16; i < 64; i++)
+    {
+        for (int l = 0; l < 4; l++)
+        {
+            uint32_t a = schedule[i - 15][l];
+            uint32_t b = schedule[i - 2][l];
+            uint32_t s0 = ROTR32(a, 7) ^ ROTR32(a, 18) ^ (a >> 3);
+            uint32_t s1 = ROTR32(b, 17) ^ ROTR32(b, 19) ^ (b >> 10);
+
+            schedule[i][l] = schedule[i - 16][l] + s0 + schedule[i - 7][l] + s1;
+        }
+    }
+
+    for (int j = 0; j < 8; j++)
+        for (int l = 0; l < 4; l++)
+            v[j][l] = state[j][l];
+
+    for (int i = 0; i < 64; i++)
+    {
+        for (int l = 0; l < 4; l++)
+        {
+            uint32_t e = v[4][l];
+            uint32_t a = v[0][l];
+
+            uint32_t t1 = v[7][l] +
+                          (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+                          ((e & v[5][l]) ^ (~e & v[6][l])) +
+                          sha256_round_constants[i] + schedule[i][l];
+            uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+                          ((a & v[1][l]) ^ (a & v[2][l]) ^ (v[1][l] & v[2][l]));
+
+            v[7][l] = v[6][l];
+            v[6][l] = v[5][l];
+            v[5][l] = e;
+            v[4][l] = v[3][l] + t1;
+            v[3][l] = v[2][l];
+            v[2][l] = v[1][l];
+            v[1][l] = a;
+            v[0][l] = t1 + t2;
+        }
+    }
+
+    for (int j = 0; j < 8; j++)
+        for (int l = 0; l < 4; l++)
+            state[j][l] += v[j][l];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define ROR256(x,n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), \
+                                    _mm256_slli_epi32((x), 32 - (n)))
+
+// eight lanes in AVX2 registers
+__attribute__((target("avx2")))
+static void compress_x8_avx2(uint32_t state[8][SHA256_MAX_LANES],
+                             uint32_t w[16][SHA256_MAX_LANES])
+{
+    __m256i s[16];
+    __m256i v[8];
+
+    for (int i = 0; i < 16; i++)
+        s[i] = _mm256_loadu_si256((const __m256i *)w[i]);
+
+    for (int j = 0; j < 8; j++)
+        v[j] = _mm256_loadu_si256((const __m256i *)state[j]);
+
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3];
+    __m256i e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int i = 0; i < 64; i++)
+    {
+        if (i >= 16)
+        {
+            __m256i x = s[(i - 15) & 15];
+            __m256i y = s[(i - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(x, 7), ROR256(x, 18)),
+                                          _mm256_srli_epi32(x, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROR256(y, 17), ROR256(y, 19)),
+                                          _mm256_srli_epi32(y, 10));
+
+            s[i & 15] = _mm256_add_epi32(_mm256_add_epi32(s[i & 15], s0),
+                                         _mm256_add_epi32(s[(i - 7) & 15], s1));
+        }
+
+        __m256i ep1 = _mm256_xor_si256(_mm256_xor_si256(ROR256(e, 6), ROR256(e, 11)),
+                                       ROR256(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f),
+                                      _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(
+            _mm256_add_epi32(h, ep1),
+            _mm256_add_epi32(_mm256_add_epi32(ch, s[i & 15]),
+                             _mm256_set1_epi32((int)sha256_round_constants[i])));
+
+        __m256i ep0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(a, 2), ROR256(a, 13)),
+                                       ROR256(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b),
+                                      _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(ep0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    __m256i out[8] = { a, b, c, d, e, f, g, h };
+
+    for (int j = 0; j < 8; j++)
+        _mm256_storeu_si256((__m256i *)state[j], _mm256_add_epi32(v[j], out[j]));
+}
+
+// sixteen lanes in AVX-512 registers, with native rotates and ternary logic
+__attribute__((target("avx512f")))
+static void compress_x16_avx512(uint32_t state[8][SHA256_MAX_LANES],
+                                uint32_t w[16][SHA256_MAX_LANES])
+{
+    __m512i s[16];
+    __m512i v[8];
+
+    for (int i = 0; i < 16; i++)
+        s[i] = _mm512_loadu_si512(w[i]);
+
+    for (int j = 0; j < 8; j++)
+        v[j] = _mm512_loadu_si512(state[j]);
+
+    __m512i a = v[0], b = v[1], c = v[2], d = v[3];
+    __m512i e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int i = 0; i < 64; i++)
+    {
+        if (i >= 16)
+        {
+            __m512i x = s[(i - 15) & 15];
+            __m512i y = s[(i - 2) & 15];
+            __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(x, 7),
+                                                   _mm512_ror_epi32(x, 18),
+                                                   _mm512_srli_epi32(x, 3), 0x96);
+            __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(y, 17),
+                                                   _mm512_ror_epi32(y, 19),
+                                                   _mm512_srli_epi32(y, 10), 0x96);
+
+            s[i & 15] = _mm512_add_epi32(_mm512_add_epi32(s[i & 15], s0),
+                                         _mm512_add_epi32(s[(i - 7) & 15], s1));
+        }
+
+        __m512i ep1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6),
+                                                _mm512_ror_epi32(e, 11),
+                                                _mm512_ror_epi32(e, 25), 0x96);
+        __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+        __m512i t1 = _mm512_add_epi32(
+            _mm512_add_epi32(h, ep1),
+            _mm512_add_epi32(_mm512_add_epi32(ch, s[i & 15]),
+                             _mm512_set1_epi32((int)sha256_round_constants[i])));
+
+        __m512i ep0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2),
+                                                _mm512_ror_epi32(a, 13),
+                                                _mm512_ror_epi32(a, 22), 0x96);
+        __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+        __m512i t2 = _mm512_add_epi32(ep0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm512_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm512_add_epi32(t1, t2);
+    }
+
+    __m512i out[8] = { a, b, c, d, e, f, g, h };
+
+    for (int j = 0; j < 8; j++)
+        _mm512_storeu_si512(state[j], _mm512_add_epi32(v[j], out[j]));
+}
+
+#endif
+
+// lane backend chosen once per process
+static pthread_once_t lanes_once = PTHREAD_ONCE_INIT;
+static Sha256LanesFn lanes_compress = compress_x4_scalar;
+static int lane_count = 4;
+static const char *lanes_name = "4-lane scalar";
+
+static void select_lanes(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        lanes_compress = compress_x16_avx512;
+        lane_count = 16;
+        lanes_name = "16-lane AVX-512";
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        lanes_compress = compress_x8_avx2;
+        lane_count = 8;
+        lanes_name = "8-lane AVX2";
+    }
+#endif
+
+    // a single hardware SHA stream outruns AVX2 or scalar lanes
+    const char *hardware_name;
+
+    if (lane_count < 16 && sha256_detect_accelerated(&hardware_name))
+    {
+        lanes_compress = NULL;
+        lane_count = 1;
+        lanes_name = hardware_name;
+    }
+}
+
+int sha256_lane_count(void)
+{
+    pthread_once(&lanes_once, select_lanes);
+    return lane_count;
+}
+
+const char *sha256_lanes_name(void)
+{
+    pthread_once(&lanes_once, select_lanes);
+    return lanes_name;
+}
+
+static uint32_t load_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// hash up to one lane group of messages side by side
+static void digest_group(const void *const *data, const size_t *lens, int n,
+                         unsigned char (*digests)[DIGEST_SIZE])
+{
+    uint32_t state[8][SHA256_MAX_LANES];
+    uint32_t saved[8][SHA256_MAX_LANES];
+    uint32_t w[16][SHA256_MAX_LANES];
+    uint8_t tails[SHA256_MAX_LANES][128];
+    size_t full_blocks[SHA256_MAX_LANES];
+    size_t total_blocks[SHA256_MAX_LANES];
+    size_t rounds = 0;
+
+    memset(state, 0, sizeof(state));
+    memset(w, 0, sizeof(w));
+
+    // padding for each message goes into its own tail buffer
+    for (int l = 0; l < n; l++)
+    {
+        const uint8_t *msg = data[l];
+        size_t len = lens[l];
+        size_t rest = len % 64;
+        size_t tail_len = rest < 56 ? 64 : 128;
+
+        full_blocks[l] = len / 64;
+        total_blocks[l] = full_blocks[l] + tail_len / 64;
+
+        memset(tails[l], 0, tail_len);
+        memcpy(tails[l], msg + full_blocks[l] * 64, rest);
+        tails[l][rest] = 0x80;
+
+        uint64_t bits_len = (uint64_t)len * 8;
+        for (int i = 0; i < 8; i++)
+            tails[l][tail_len - 8 + i] = (bits_len >> ((7 - i) * 8)) & 0xff;
+
+        for (int j = 0; j < 8; j++)
+            state[j][l] = initial_state[j];
+
+        if (total_blocks[l] > rounds)
+            rounds = total_blocks[l];
+    }
+
+    for (size_t r = 0; r < rounds; r++)
+    {
+        int finished = 0;
+
+        for (int l = 0; l < n; l++)
+        {
+            const uint8_t *block;
+
+            if (r < full_blocks[l])
+                block = (const uint8_t *)data[l] + r * 64;
+            else if (r < total_blocks[l])
+                block = tails[l] + (r - full_blocks[l]) * 64;
+            else
+            {
+                finished = 1;
+                continue;
+            }
+
+            for (int i = 0; i < 16; i++)
+                w[i][l] = load_be32(block + 4 * i);
+        }
+
+        // lanes that already ended keep their state across this round
+        if (finished)
+            memcpy(saved, state, sizeof(state));
+
+        lanes_compress(state, w);
+
+        if (finished)
+        {
+            for (int l = 0; l < n; l++)
+                if (r >= total_blocks[l])
+                    for (int j = 0; j < 8; j++)
+                        state[j][l] = saved[j][l];
+        }
+    }
+
+    for (int l = 0; l < n; l++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            digests[l][j*4] = (state[j][l] >> 24) & 0xff;
+            digests[l][j*4 + 1] = (state[j][l] >> 16) & 0xff;
+            digests[l][j*4 + 2] = (state[j][l] >> 8) & 0xff;
+            digests[l][j*4 + 3] = state[j][l] & 0xff;
+        }
+    }
+}
+
+// hash many independent messages, one lane group at a time
+void sha256_digest_many(const void *const *data, const size_t *lens, int count,
+                        unsigned char (*digests)[DIGEST_SIZE])
+{
+    pthread_once(&lanes_once, select_lanes);
+
+    if (!lanes_compress)
+    {
+        for (int i = 0; i < count; i++)
+            sha256_digest(data[i], lens[i], digests[i]);
+        return;
+    }
+
+    for (int base = 0; base < count; base += lane_count)
+    {
+        int n = count - base;
+        if (n > lane_count)
+            n = lane_count;
+
+        digest_group(data + base, lens + base, n, digests + base);
+    }
+}
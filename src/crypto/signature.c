@@ -1,45 +1,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include <openssl/evp.h>
 #include <openssl/pem.h>
 #include <openssl/err.h>
 
 #include "signature.h"
+#include "key_registry.h"
+#include "hex.h"
 
-// binary to hex string
-void bin_to_hex(const unsigned char *bin, size_t len, char *hex)
-{
-    for (size_t i = 0; i < len; i++)
-        sprintf(hex + (i * 2), "%02x", bin[i]);
+// items claimed by a batch worker at a time; must stay a multiple of 8
+#define SIGNATURE_BATCH_CHUNK 32
+#define SIGNATURE_BATCH_MAX_THREADS 64
 
-    hex[len * 2] = '\0';
-}
+// batches up to this size are verified inline; a certificate always is
+#define SIGNATURE_BATCH_INLINE 64
 
-// hex string to binary
-int hex_to_bin(const char *hex, unsigned char *bin)
-{
-    size_t len = strlen(hex);
-    if (len % 2 != 0)
-        return 0;
-
-    for (size_t i = 0; i < len / 2; i++)
-        sscanf(hex + 2 * i, "%2hhx", &bin[i]);
-
-    return len / 2;
-}
-
-// sign data using OpenSSL EVP
-int sign_data(const char *data,
-              const char *private_key_path,
-              char signature_hex[513])
+// load a private key once and prepare reusable signing state
+Signer *signer_open(const char *private_key_path)
 {
     FILE *fp = fopen(private_key_path, "r");
     if (!fp)
     {
         printf("[CRYPTO] Private key file not found: %s\n", private_key_path);
-        return 0;
+        return NULL;
     }
 
     EVP_PKEY *pkey = PEM_read_PrivateKey(fp, NULL, NULL, NULL);
@@ -48,114 +35,289 @@ int sign_data(const char *data,
     if (!pkey)
     {
         printf("[CRYPTO] Failed to load private key.\n");
-        return 0;
+        return NULL;
     }
 
-    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-    if (!ctx)
+    Signer *signer = calloc(1, sizeof(Signer));
+    if (!signer)
     {
         EVP_PKEY_free(pkey);
-        return 0;
+        return NULL;
     }
 
-    if (EVP_DigestSignInit(ctx, NULL, EVP_sha256(), NULL, pkey) <= 0)
+    signer->pkey = pkey;
+    signer->template_ctx = EVP_MD_CTX_new();
+    signer->ctx = EVP_MD_CTX_new();
+    signer->sig_capacity = EVP_PKEY_get_size(pkey);
+    signer->sig_buffer = malloc(signer->sig_capacity);
+    pthread_mutex_init(&signer->lock, NULL);
+
+    if (!signer->template_ctx || !signer->ctx || !signer->sig_buffer ||
+        signer->sig_capacity * 2 >= SIGNATURE_HEX_SIZE ||
+        EVP_DigestSignInit(signer->template_ctx, NULL, EVP_sha256(), NULL, pkey) <= 0)
     {
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
-        return 0;
+        signer_close(signer);
+        return NULL;
     }
 
-    if (EVP_DigestSignUpdate(ctx, data, strlen(data)) <= 0)
-    {
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
+    return signer;
+}
+
+// sign data from the preallocated state
+int signer_sign(Signer *signer,
+                const char *data,
+                char signature_hex[SIGNATURE_HEX_SIZE])
+{
+    pthread_mutex_lock(&signer->lock);
+
+    int ok = EVP_MD_CTX_copy_ex(signer->ctx, signer->template_ctx) ||
+             EVP_DigestSignInit(signer->ctx, NULL, EVP_sha256(), NULL, signer->pkey) > 0;
+
+    size_t sig_len = signer->sig_capacity;
+
+    if (ok)
+        ok = EVP_DigestSign(signer->ctx, signer->sig_buffer, &sig_len,
+                            (const unsigned char *)data, strlen(data)) > 0;
+
+    if (ok)
+        hex_encode(signer->sig_buffer, sig_len, signature_hex);
+
+    pthread_mutex_unlock(&signer->lock);
+
+    return ok;
+}
+
+void signer_close(Signer *signer)
+{
+    if (!signer)
+        return;
+
+    EVP_MD_CTX_free(signer->template_ctx);
+    EVP_MD_CTX_free(signer->ctx);
+    EVP_PKEY_free(signer->pkey);
+    free(signer->sig_buffer);
+    pthread_mutex_destroy(&signer->lock);
+    free(signer);
+}
+
+// one-off signing; long-running callers should keep a Signer
+int sign_data(const char *data,
+              const char *private_key_path,
+              char signature_hex[SIGNATURE_HEX_SIZE])
+{
+    Signer *signer = signer_open(private_key_path);
+    if (!signer)
         return 0;
-    }
 
-    size_t sig_len;
-    EVP_DigestSignFinal(ctx, NULL, &sig_len);
+    int ok = signer_sign(signer, data, signature_hex);
+    signer_close(signer);
 
-    unsigned char *sig = malloc(sig_len);
-    if (!sig)
-    {
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
+    return ok;
+}
+
+// check one signature on an already allocated context
+static int verify_with_context(EVP_MD_CTX *ctx,
+                               const char *data,
+                               const char *public_key_path,
+                               const char *signature_hex)
+{
+    unsigned char sig_bin[512];
+
+    if (!data || !public_key_path || !signature_hex)
         return 0;
-    }
 
-    if (EVP_DigestSignFinal(ctx, sig, &sig_len) <= 0)
-    {
-        free(sig);
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
+    size_t sig_len = hex_decode(signature_hex, sig_bin, sizeof(sig_bin));
+    if (sig_len == 0)
         return 0;
-    }
 
-    bin_to_hex(sig, sig_len, signature_hex);
+    if (!prepare_verify_context(public_key_path, ctx))
+        return 0;
 
-    free(sig);
-    EVP_MD_CTX_free(ctx);
-    EVP_PKEY_free(pkey);
+    int result = EVP_DigestVerify(ctx, sig_bin, sig_len,
+                                  (const unsigned char *)data, strlen(data));
 
-    return 1;
+    return result == 1;
 }
 
-// verify signature using OpenSSL EVP
+// verify signature using OpenSSL EVP and the cached validator key
 int verify_signature(const char *data,
                      const char *public_key_path,
                      const char *signature_hex)
 {
-    FILE *fp = fopen(public_key_path, "r");
-    if (!fp)
-    {
-        printf("[CRYPTO] Public key file not found: %s\n", public_key_path);
+    EVP_MD_CTX *ctx = thread_verify_context();
+    if (!ctx)
         return 0;
-    }
 
-    EVP_PKEY *pkey = PEM_read_PUBKEY(fp, NULL, NULL, NULL);
-    fclose(fp);
+    return verify_with_context(ctx, data, public_key_path, signature_hex);
+}
 
-    if (!pkey)
-    {
-        printf("[CRYPTO] Failed to load public key.\n");
-        return 0;
-    }
+// a batch being verified; chunk bookkeeping is guarded by pool_lock
+typedef struct BatchState {
+    const SignatureCheck *items;
+    int count;
+    unsigned char *results;
+
+    int next_chunk;
+    int busy;                   // chunks held by pool workers
+    int valid;
+    struct BatchState *next;    // queued batches
+} BatchState;
+
+// workers started once and shared by every batch
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static BatchState *pool_queue = NULL;
+
+// claim the next chunk of a batch, or -1 when all are handed out
+static int claim_batch_chunk_locked(BatchState *state)
+{
+    int start = state->next_chunk;
+
+    if (start >= state->count)
+        return -1;
+
+    state->next_chunk += SIGNATURE_BATCH_CHUNK;
+    return start;
+}
+
+// chunks are multiples of 8 items, so each bitmap byte has a single writer
+static int verify_batch_range(EVP_MD_CTX *ctx, BatchState *state, int start, int end)
+{
+    int valid = 0;
 
-    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
     if (!ctx)
-    {
-        EVP_PKEY_free(pkey);
         return 0;
-    }
 
-    if (EVP_DigestVerifyInit(ctx, NULL, EVP_sha256(), NULL, pkey) <= 0)
+    for (int i = start; i < end; i++)
     {
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
-        return 0;
+        const SignatureCheck *item = &state->items[i];
+
+        if (verify_with_context(ctx,
+                                item->data,
+                                item->public_key_path,
+                                item->signature_hex))
+        {
+            state->results[i / 8] |= (unsigned char)(1u << (i % 8));
+            valid++;
+        }
     }
 
-    if (EVP_DigestVerifyUpdate(ctx, data, strlen(data)) <= 0)
+    return valid;
+}
+
+static int chunk_end(const BatchState *state, int start)
+{
+    int end = start + SIGNATURE_BATCH_CHUNK;
+    return end > state->count ? state->count : end;
+}
+
+// pool thread: take chunks from whichever queued batch still has some
+static void *batch_worker(void *arg)
+{
+    (void)arg;
+    EVP_MD_CTX *ctx = thread_verify_context();
+
+    pthread_mutex_lock(&pool_lock);
+
+    while (1)
     {
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
-        return 0;
+        BatchState *state = pool_queue;
+        while (state && state->next_chunk >= state->count)
+            state = state->next;
+
+        if (!state)
+        {
+            pthread_cond_wait(&pool_work, &pool_lock);
+            continue;
+        }
+
+        int start = claim_batch_chunk_locked(state);
+        state->busy++;
+
+        pthread_mutex_unlock(&pool_lock);
+        int valid = verify_batch_range(ctx, state, start, chunk_end(state, start));
+        pthread_mutex_lock(&pool_lock);
+
+        state->valid += valid;
+
+        if (--state->busy == 0)
+            pthread_cond_broadcast(&pool_done);
     }
 
-    unsigned char sig_bin[512];
-    int sig_len = hex_to_bin(signature_hex, sig_bin);
+    return NULL;
+}
+
+// one worker per core besides the callers, which verify too
+static void start_batch_pool(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores > 1 ? (int)cores - 1 : 0;
+
+    if (threads > SIGNATURE_BATCH_MAX_THREADS)
+        threads = SIGNATURE_BATCH_MAX_THREADS;
 
-    if (sig_len <= 0)
+    for (int i = 0; i < threads; i++)
     {
-        EVP_MD_CTX_free(ctx);
-        EVP_PKEY_free(pkey);
+        pthread_t thread_id;
+
+        if (pthread_create(&thread_id, NULL, batch_worker, NULL) == 0)
+            pthread_detach(thread_id);
+    }
+}
+
+// verify many signatures sharing the cached keys; small batches stay on the
+// calling thread, larger ones are split across the persistent pool
+int verify_signatures_batch(const SignatureCheck *items,
+                            int count,
+                            unsigned char *results)
+{
+    if (count <= 0)
         return 0;
+
+    memset(results, 0, SIGNATURE_BITMAP_SIZE(count));
+
+    BatchState state;
+    memset(&state, 0, sizeof(state));
+    state.items = items;
+    state.count = count;
+    state.results = results;
+
+    EVP_MD_CTX *ctx = thread_verify_context();
+
+    if (count <= SIGNATURE_BATCH_INLINE)
+        return verify_batch_range(ctx, &state, 0, count);
+
+    pthread_once(&pool_once, start_batch_pool);
+
+    pthread_mutex_lock(&pool_lock);
+
+    state.next = pool_queue;
+    pool_queue = &state;
+    pthread_cond_broadcast(&pool_work);
+
+    // the calling thread works too
+    int start;
+
+    while ((start = claim_batch_chunk_locked(&state)) != -1)
+    {
+        pthread_mutex_unlock(&pool_lock);
+        int valid = verify_batch_range(ctx, &state, start, chunk_end(&state, start));
+        pthread_mutex_lock(&pool_lock);
+
+        state.valid += valid;
     }
 
-    int result = EVP_DigestVerifyFinal(ctx, sig_bin, sig_len);
+    while (state.busy > 0)
+        pthread_cond_wait(&pool_done, &pool_lock);
 
-    EVP_MD_CTX_free(ctx);
-    EVP_PKEY_free(pkey);
+    BatchState **link = &pool_queue;
+    while (*link != &state)
+        link = &(*link)->next;
+    *link = state.next;
 
-    return result == 1;
+    pthread_mutex_unlock(&pool_lock);
+
+    return state.valid;
 }
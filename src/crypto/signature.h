@@ -1,12 +1,50 @@
 #ifndef SIGNATURE_H
 #define SIGNATURE_H
 
+#include <stddef.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+
+#define SIGNATURE_HEX_SIZE 513
+
+// long-lived signing state for one private key
+typedef struct {
+    EVP_PKEY *pkey;
+    EVP_MD_CTX *template_ctx;   // DigestSignInit already applied
+    EVP_MD_CTX *ctx;
+    unsigned char *sig_buffer;
+    size_t sig_capacity;
+    pthread_mutex_t lock;
+} Signer;
+
+Signer *signer_open(const char *private_key_path);
+int signer_sign(Signer *signer,
+                const char *data,
+                char signature_hex[SIGNATURE_HEX_SIZE]);
+void signer_close(Signer *signer);
+
 int sign_data(const char *data,
               const char *private_key_path,
-              char signature_hex[513]);
+              char signature_hex[SIGNATURE_HEX_SIZE]);
 
 int verify_signature(const char *data,
                      const char *public_key_path,
                      const char *signature_hex);
 
+// one entry of a batched verification
+typedef struct {
+    const char *data;
+    const char *public_key_path;
+    const char *signature_hex;
+} SignatureCheck;
+
+// bytes needed for the result bitmap of a batch
+#define SIGNATURE_BITMAP_SIZE(count) (((count) + 7) / 8)
+#define SIGNATURE_BIT(bitmap, i) (((bitmap)[(i) / 8] >> ((i) % 8)) & 1)
+
+// sets bit i of results when item i verifies; returns the number of valid items
+int verify_signatures_batch(const SignatureCheck *items,
+                            int count,
+                            unsigned char *results);
+
 #endif
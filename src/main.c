@@ -9,7 +9,7 @@
 
 #define OFFCHAIN_DIR "offchain/records/"
 
-int hash_file(const char *filename, char *output_hash) {
+int hash_file(const char *filename, Digest *output_hash) {
     FILE *fp = fopen(filename, "r");
     if (!fp) {
         printf("ERROR: Cannot open file %s\n", filename);
@@ -42,28 +42,10 @@ int hash_file(const char *filename, char *output_hash) {
         line_count
     );
 
-    sha256(fingerprint, output_hash);
+    sha256_digest(fingerprint, strlen(fingerprint), output_hash->bytes);
     return 1;
 }
 
-int record_exists(const char *data_hash) {
-    FILE *fp = fopen("data/blockchain.dat", "rb");
-    if (!fp) return 0;
-
-    Block block;
-    while (fread(&block, sizeof(Block), 1, fp) == 1) {
-        for (int i = 0; i < block.transaction_count; i++) {
-            if (strcmp(block.transactions[i].data_hash, data_hash) == 0) {
-                fclose(fp);
-                return 1;
-            }
-        }
-    }
-
-    fclose(fp);
-    return 0;
-}
-
 // main entry point
 int main() {
     printf("Blockchain starting...\n");
@@ -76,6 +58,7 @@ int main() {
         printf("No blockchain found. Creating genesis block...\n");
         create_genesis_block(&last_block);
         add_block(&last_block);
+        free_block(&last_block);
 
         // reload to ensure we have the latest state
         get_last_block(&last_block);
@@ -98,12 +81,12 @@ int main() {
              record_name);
 
     // hash the file content
-    if (!hash_file(tx.data_pointer, tx.data_hash)) {
+    if (!hash_file(tx.data_pointer, &tx.data_hash)) {
         return 1;
     }
 
     // avoid duplicates
-    if (record_exists(tx.data_hash)) {
+    if (transaction_hash_exists(&tx.data_hash)) {
         printf("ERROR: This medical record already exists in the blockchain.\n");
         return 0;
     }
@@ -112,16 +95,22 @@ int main() {
 
     // create new block
     Block block;
-    init_block(&block, last_block.index + 1, last_block.block_hash);
-    add_transaction(&block, tx);
+    init_block(&block, last_block.index + 1, &last_block.block_hash);
+    free_block(&last_block);
+    add_transaction(&block, &tx);
 
     // calculate hash and sign the block
-    sha256(tx.data_hash, block.block_hash);
-    sign_data(block.block_hash,
+    char hex[DIGEST_HEX_SIZE];
+    digest_to_hex(&tx.data_hash, hex);
+    sha256_digest(hex, strlen(hex), block.block_hash.bytes);
+
+    digest_to_hex(&block.block_hash, hex);
+    sign_data(hex,
               "hospital_private_key",
               block.validator_signature);
 
     add_block(&block);
+    free_block(&block);
     printf("Medical record block added.\n");
 
     // integrity check
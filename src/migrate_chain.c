@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blockchain/block.h"
+#include "blockchain/storage.h"
+
+// raw struct layout written by the original add_block()
+#define LEGACY_HASH_SIZE 513
+#define LEGACY_MAX_TRANSACTIONS 5
+
+typedef struct {
+    char patient_id[32];
+    char doctor_id[32];
+    char data_hash[LEGACY_HASH_SIZE];
+    char data_pointer[128];
+    time_t timestamp;
+} LegacyTransaction;
+
+typedef struct {
+    int index;
+    time_t timestamp;
+    char previous_hash[LEGACY_HASH_SIZE];
+    char block_hash[LEGACY_HASH_SIZE];
+    char validator_signature[LEGACY_HASH_SIZE];
+    int validator_port;
+    LegacyTransaction transactions[LEGACY_MAX_TRANSACTIONS];
+    int transaction_count;
+} LegacyBlock;
+
+// bounded copy of a possibly unterminated legacy field
+static void copy_field(char *dst, size_t dst_size, const char *src, size_t src_size)
+{
+    size_t len = strnlen(src, src_size);
+    if (len >= dst_size)
+        len = dst_size - 1;
+
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+// legacy hex (or the genesis "0") to a digest
+static int copy_digest(Digest *dst, const char *src, size_t src_size)
+{
+    char hex[LEGACY_HASH_SIZE + 1];
+
+    copy_field(hex, sizeof(hex), src, src_size);
+    return digest_parse(hex, dst);
+}
+
+// on failure the block may hold a partial list; the caller frees it
+static int convert_block(const LegacyBlock *legacy, Block *block)
+{
+    memset(block, 0, sizeof(Block));
+
+    if (legacy->transaction_count < 0 ||
+        legacy->transaction_count > LEGACY_MAX_TRANSACTIONS ||
+        !reserve_transactions(block, legacy->transaction_count))
+        return 0;
+
+    // fixed-layout files predate block versions
+    block->version = BLOCK_VERSION_LEGACY;
+    block->index = legacy->index;
+    block->timestamp = legacy->timestamp;
+    block->validator_port = legacy->validator_port;
+
+    if (!copy_digest(&block->previous_hash,
+                     legacy->previous_hash, sizeof(legacy->previous_hash)) ||
+        !copy_digest(&block->block_hash,
+                     legacy->block_hash, sizeof(legacy->block_hash)))
+        return 0;
+
+    copy_field(block->validator_signature, sizeof(block->validator_signature),
+               legacy->validator_signature, sizeof(legacy->validator_signature));
+
+    for (int i = 0; i < legacy->transaction_count; i++)
+    {
+        const LegacyTransaction *in = &legacy->transactions[i];
+        Transaction out;
+
+        memset(&out, 0, sizeof(out));
+        copy_field(out.patient_id, sizeof(out.patient_id),
+                   in->patient_id, sizeof(in->patient_id));
+        copy_field(out.doctor_id, sizeof(out.doctor_id),
+                   in->doctor_id, sizeof(in->doctor_id));
+        if (!copy_digest(&out.data_hash, in->data_hash, sizeof(in->data_hash)))
+            return 0;
+
+        copy_field(out.data_pointer, sizeof(out.data_pointer),
+                   in->data_pointer, sizeof(in->data_pointer));
+        out.timestamp = in->timestamp;
+
+        if (!add_transaction(block, &out))
+            return 0;
+    }
+
+    return 1;
+}
+
+// decoded record must match the converted block field for field
+static int same_block(const Block *a, const Block *b)
+{
+    if (a->version != b->version ||
+        a->index != b->index ||
+        a->timestamp != b->timestamp ||
+        a->validator_port != b->validator_port ||
+        a->transaction_count != b->transaction_count ||
+        !digest_equal(&a->previous_hash, &b->previous_hash) ||
+        !digest_equal(&a->block_hash, &b->block_hash) ||
+        !digest_equal(&a->merkle_root, &b->merkle_root) ||
+        strcmp(a->validator_signature, b->validator_signature) != 0)
+        return 0;
+
+    for (int i = 0; i < a->transaction_count; i++)
+    {
+        const Transaction *x = &a->transactions[i];
+        const Transaction *y = &b->transactions[i];
+
+        if (strcmp(x->patient_id, y->patient_id) != 0 ||
+            strcmp(x->doctor_id, y->doctor_id) != 0 ||
+            !digest_equal(&x->data_hash, &y->data_hash) ||
+            strcmp(x->data_pointer, y->data_pointer) != 0 ||
+            x->timestamp != y->timestamp)
+            return 0;
+    }
+
+    return 1;
+}
+
+// drop sidecars built against the old layout
+static void remove_sidecars(const char *path)
+{
+    const char *exts[] = { ".idx", ".txi", ".vck", ".qcs" };
+    size_t len = strlen(path);
+    char sidecar[512];
+
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++)
+    {
+        if (len > 4 && strcmp(path + len - 4, ".dat") == 0)
+            snprintf(sidecar, sizeof(sidecar), "%.*s%s", (int)(len - 4), path, exts[i]);
+        else
+            snprintf(sidecar, sizeof(sidecar), "%s%s", path, exts[i]);
+
+        unlink(sidecar);
+    }
+}
+
+// blocks re-hashed together while importing
+#define MIGRATE_HASH_BATCH 64
+
+// largest record a fixed-layout block can produce
+#define LEGACY_RECORD_MAX (BLOCK_RECORD_FIXED + LEGACY_MAX_TRANSACTIONS * BLOCK_RECORD_TX_MAX)
+
+// re-hash converted blocks in one multi-lane batch and release them;
+// returns the mismatches
+static int count_hash_mismatches(Block *blocks, int count)
+{
+    Digest hashes[MIGRATE_HASH_BATCH];
+    int mismatches = 0;
+
+    calculate_block_hashes(blocks, count, hashes);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!digest_equal(&hashes[i], &blocks[i].block_hash))
+        {
+            printf("Block %d does not match its stored hash\n", blocks[i].index);
+            mismatches++;
+        }
+
+        free_block(&blocks[i]);
+    }
+
+    return mismatches;
+}
+
+int migrate_file(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        printf("Cannot open %s\n", path);
+        return 0;
+    }
+
+    unsigned char header[CHAIN_HEADER_SIZE];
+    size_t got = fread(header, 1, sizeof(header), in);
+
+    if (check_chain_header(header, got))
+    {
+        printf("%s is already in the current format\n", path);
+        fclose(in);
+        return 1;
+    }
+
+    rewind(in);
+
+    char tmp_path[512];
+    char backup_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    snprintf(backup_path, sizeof(backup_path), "%s.bak", path);
+
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out)
+    {
+        printf("Cannot create %s\n", tmp_path);
+        fclose(in);
+        return 0;
+    }
+
+    write_chain_header(header);
+    fwrite(header, 1, sizeof(header), out);
+
+    Block *batch = malloc(sizeof(Block) * MIGRATE_HASH_BATCH);
+    if (!batch)
+    {
+        fclose(in);
+        fclose(out);
+        unlink(tmp_path);
+        return 0;
+    }
+
+    LegacyBlock legacy;
+    Block block, check;
+    int batched = 0;
+    int mismatches = 0;
+    unsigned char record[LEGACY_RECORD_MAX + 4];
+    long old_bytes = 0;
+    long new_bytes = sizeof(header);
+    int count = 0;
+    int ok = 1;
+
+    memset(&check, 0, sizeof(check));
+
+    while (fread(&legacy, sizeof(legacy), 1, in) == 1)
+    {
+        size_t len = 0;
+
+        if (!convert_block(&legacy, &block) ||
+            (len = encode_block_record(&block, record, sizeof(record))) == 0 ||
+            !decode_block_record(record, len, &check, NULL) ||
+            !same_block(&block, &check))
+        {
+            printf("Block %d in %s could not be converted\n", count, path);
+            free_block(&block);
+            free_block(&check);
+            ok = 0;
+            break;
+        }
+
+        free_block(&check);
+
+        if (fwrite(record, 1, len, out) != len)
+        {
+            printf("Write to %s failed\n", tmp_path);
+            free_block(&block);
+            ok = 0;
+            break;
+        }
+
+        old_bytes += sizeof(legacy);
+        new_bytes += len;
+        count++;
+
+        batch[batched++] = block;
+
+        if (batched == MIGRATE_HASH_BATCH)
+        {
+            mismatches += count_hash_mismatches(batch, batched);
+            batched = 0;
+        }
+    }
+
+    if (batched > 0)
+        mismatches += count_hash_mismatches(batch, batched);
+
+    free(batch);
+
+    if (ok && !feof(in))
+        ok = 0;
+
+    long trailing = ftell(in) - old_bytes;
+    fclose(in);
+
+    if (fclose(out) != 0)
+        ok = 0;
+
+    if (!ok)
+    {
+        unlink(tmp_path);
+        return 0;
+    }
+
+    if (trailing > 0)
+        printf("Ignored %ld trailing bytes of a partial block\n", trailing);
+
+    // the chain is copied as-is; verify_blockchain() will reject it later
+    if (mismatches > 0)
+        printf("Warning: %d block(s) in %s fail hash validation\n", mismatches, path);
+
+    if (rename(path, backup_path) != 0 || rename(tmp_path, path) != 0)
+    {
+        printf("Failed to replace %s\n", path);
+        return 0;
+    }
+
+    remove_sidecars(path);
+
+    printf("Migrated %s: %d blocks, %ld -> %ld bytes (backup: %s)\n",
+           path, count, old_bytes, new_bytes, backup_path);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <chain.dat> [chain.dat...]\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!migrate_file(argv[i]))
+            failed++;
+    }
+
+    printf("Migration complete.\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "assembler.h"
+#include "proposal.h"
+#include "node.h"
+#include "../blockchain/blockchain.h"
+#include "../blockchain/mempool.h"
+
+// assembler state
+static pthread_t assembler_thread;
+static int assembler_running = 0;
+static Signer *assembler_signer = NULL;
+static int assembler_port = 0;
+
+// a proposed block and the mempool batch it carries
+typedef struct {
+    int index;
+    Digest hash;
+    int batch;
+    int active;
+} InFlightBlock;
+
+static InFlightBlock in_flight[PIPELINE_DEPTH_MAX];
+
+// hand batches back once their block committed or its proposal was dropped
+static void reap_in_flight()
+{
+    int height = get_blockchain_height();
+
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (!in_flight[i].active)
+            continue;
+
+        if (height > in_flight[i].index ||
+            !proposal_pending(in_flight[i].index, &in_flight[i].hash))
+        {
+            // committed records leave the pool, the others go into a later block
+            mempool_release(in_flight[i].batch);
+            in_flight[i].active = 0;
+        }
+    }
+}
+
+static InFlightBlock *free_in_flight_slot()
+{
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (!in_flight[i].active)
+            return &in_flight[i];
+    }
+
+    return NULL;
+}
+
+// build, sign and propose one block on top of the newest proposal
+static void assemble_block()
+{
+    InFlightBlock *slot = free_in_flight_slot();
+
+    int tip_index;
+    Digest tip_hash;
+
+    if (!slot || !proposal_tip(&tip_index, &tip_hash))
+        return;
+
+    Block block;
+    memset(&block, 0, sizeof(Block));
+
+    init_block(&block, tip_index + 1, &tip_hash);
+
+    int batch;
+    if (mempool_take(&block, &batch) == 0)
+    {
+        free_block(&block);
+        return;
+    }
+
+    calculate_block_hash(&block);
+    block.validator_port = assembler_port;
+
+    char hash_hex[DIGEST_HEX_SIZE];
+    digest_to_hex(&block.block_hash, hash_hex);
+
+    if (!signer_sign(assembler_signer, hash_hex, block.validator_signature))
+    {
+        printf("[CRYPTO] Signing failed.\n");
+        mempool_release(batch);
+        free_block(&block);
+        return;
+    }
+
+    printf("[CONSENSUS] Proposing block %d with %d record(s)\n",
+           block.index, block.transaction_count);
+
+    if (!propose_block(&block))
+    {
+        mempool_release(batch);
+        free_block(&block);
+        return;
+    }
+
+    slot->index = block.index;
+    slot->hash = block.block_hash;
+    slot->batch = batch;
+    slot->active = 1;
+
+    free_block(&block);
+}
+
+// keep up to the pipeline depth of proposals in flight; the next block is
+// proposed while earlier ones are still collecting votes
+static void *assembler_runner(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        expire_proposals();
+        reap_in_flight();
+
+        int proposed = proposals_in_flight();
+
+        // a full pipeline or peers still draining earlier blocks hold back
+        // the next proposal
+        if (proposed >= get_pipeline_depth() || outbound_backlogged())
+        {
+            usleep(1000);
+            continue;
+        }
+
+        // with nothing in flight there is nothing to reap, so wait longer
+        int ready = mempool_wait_batch(proposed > 0 ? ASSEMBLER_POLL_MS
+                                                    : ASSEMBLER_IDLE_MS);
+
+        if (ready < 0)
+            break;
+
+        if (ready > 0)
+            assemble_block();
+    }
+
+    // batches still in flight go back to the pool
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (in_flight[i].active)
+            mempool_release(in_flight[i].batch);
+
+        in_flight[i].active = 0;
+    }
+
+    return NULL;
+}
+
+// start turning mempool batches into proposals
+int start_block_assembler(Signer *signer, int validator_port)
+{
+    if (assembler_running)
+        return 1;
+
+    if (!signer)
+        return 0;
+
+    if (!mempool_init(MEMPOOL_CAPACITY, MEMPOOL_BATCH_SIZE, MEMPOOL_DEADLINE_MS))
+        return 0;
+
+    assembler_signer = signer;
+    assembler_port = validator_port;
+
+    if (pthread_create(&assembler_thread, NULL, assembler_runner, NULL) != 0)
+    {
+        mempool_close();
+        return 0;
+    }
+
+    assembler_running = 1;
+    return 1;
+}
+
+// stop the assembler thread; a round in progress finishes first
+void stop_block_assembler()
+{
+    if (!assembler_running)
+        return;
+
+    mempool_shutdown();
+    pthread_join(assembler_thread, NULL);
+    mempool_close();
+
+    assembler_running = 0;
+}
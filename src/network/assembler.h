@@ -0,0 +1,13 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include "../crypto/signature.h"
+
+// how often the assembler checks for committed or expired proposals
+#define ASSEMBLER_POLL_MS 10
+#define ASSEMBLER_IDLE_MS 500
+
+int start_block_assembler(Signer *signer, int validator_port);
+void stop_block_assembler();
+
+#endif
@@ -2,217 +2,1178 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <time.h>
 
 #include "protocol.h"
 #include "node.h"
+#include "wire.h"
+#include "../blockchain/quorum.h"
 
-Peer peers[MAX_PEERS];
-int peer_count = 0;
-pthread_mutex_t peer_lock = PTHREAD_MUTEX_INITIALIZER;
+// a complete frame waiting for a worker; control payloads lie in the
+// receive ring unless the frame was large or wrapped, all others are owned
+typedef struct InboundMessage {
+    int type;
+    const char *payload;
+    size_t len;
+    char *owned;
+    size_t ring_end;      // ring space up to here is free once handled
+    struct timespec queued_at;
+    struct InboundMessage *next;
+} InboundMessage;
 
-// get peer index from socket
-int find_peer_by_socket(int socket)
+// one queued reference to a shared message
+typedef struct OutboundEntry {
+    SharedBuffer *buffer;
+    struct OutboundEntry *next;
+} OutboundEntry;
+
+// one connection; its I/O thread reads it, one worker at a time handles
+// its messages, and any thread may queue output for it
+typedef struct Peer {
+    int socket;
+    int port;
+    int validator_port;   // announced or dialed validator, 0 when unknown
+    time_t last_seen;
+    int io_thread;
+    int refs;             // the table entry plus each worker holding it
+    int closing;
+
+    // receive ring; the counters only grow and are taken modulo its size.
+    // head and parsed belong to the I/O thread, workers advance tail
+    char *ring;
+    size_t ring_head;
+    size_t ring_parsed;
+    size_t ring_tail;
+    size_t ring_mark;     // ring_parsed when the last message was queued
+    int ring_pending;     // queued messages still reading from the ring
+
+    // a frame too large for the ring is received into its own buffer
+    char *large_frame;
+    size_t large_len;
+    size_t large_got;
+    int large_type;
+
+    int wire_version;     // 0 until the peer's hello arrived
+
+    // messages of each lane in arrival order; a scheduled lane is owned by
+    // one worker, so different lanes of a peer may run side by side
+    InboundMessage *inbox_head[LANE_COUNT];
+    InboundMessage *inbox_tail[LANE_COUNT];
+    int inbox_count;
+    int paused;
+    int scheduled[LANE_COUNT];
+    struct Peer *next_ready[LANE_COUNT];
+
+    // bounded queue of output the socket has not taken yet; head_sent
+    // bytes of the first entry are already out
+    OutboundEntry *outbox_head;
+    OutboundEntry *outbox_tail;
+    size_t outbox_bytes;
+    int outbox_count;
+    size_t head_sent;
+    time_t last_progress;
+
+    pthread_mutex_t lock;
+} Peer;
+
+// connections indexed by socket
+static Peer *peers[MAX_PEERS];
+static int peer_count = 0;
+static pthread_mutex_t peer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// validator port this node announces on outbound connections
+static int local_port = 0;
+
+// epoll sets, each served by one I/O thread
+static int epoll_fds[NODE_IO_THREADS];
+static int listen_socket = -1;
+
+// peers with messages waiting, one queue per lane, served by the worker pool
+static Peer *ready_head[LANE_COUNT];
+static Peer *ready_tail[LANE_COUNT];
+static int bulk_workers_busy = 0;
+static pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_once_t node_once = PTHREAD_ONCE_INIT;
+static int node_ready = 0;
+
+
+// take ownership of a malloc'd frame, NULL passes through; the frame is
+// freed with the last reference
+SharedBuffer *shared_buffer_wrap(char *data, size_t len)
 {
-    for (int i = 0; i < MAX_PEERS; i++)
+    if (!data)
+        return NULL;
+
+    SharedBuffer *buffer = malloc(sizeof(SharedBuffer));
+
+    if (!buffer)
     {
-        if (peers[i].active && peers[i].socket == socket)
-            return i;
+        free(data);
+        return NULL;
     }
-    return -1;
+
+    buffer->data = data;
+    buffer->len = len;
+    buffer->refs = 1;
+    pthread_mutex_init(&buffer->lock, NULL);
+
+    return buffer;
 }
 
-// disconnect and remove peer
-void remove_peer(int socket)
+static void shared_buffer_hold(SharedBuffer *buffer)
 {
-    pthread_mutex_lock(&peer_lock);
+    pthread_mutex_lock(&buffer->lock);
+    buffer->refs++;
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+void shared_buffer_release(SharedBuffer *buffer)
+{
+    if (!buffer)
+        return;
+
+    pthread_mutex_lock(&buffer->lock);
+    int last = --buffer->refs == 0;
+    pthread_mutex_unlock(&buffer->lock);
 
-    int index = find_peer_by_socket(socket);
-    if (index != -1)
+    if (last)
     {
-        printf("[NETWORK] Peer %d disconnected.\n", peers[index].port);
+        pthread_mutex_destroy(&buffer->lock);
+        free(buffer->data);
+        free(buffer);
+    }
+}
 
-        close(peers[index].socket);
-        peers[index].active = 0;
-        peer_count--;
+static void drop_outbox_head_locked(Peer *peer)
+{
+    OutboundEntry *entry = peer->outbox_head;
+
+    peer->outbox_head = entry->next;
+
+    if (!peer->outbox_head)
+        peer->outbox_tail = NULL;
+
+    peer->outbox_bytes -= entry->buffer->len - peer->head_sent;
+    peer->outbox_count--;
+    peer->head_sent = 0;
+
+    shared_buffer_release(entry->buffer);
+    free(entry);
+}
+
+static void free_peer(Peer *peer)
+{
+    while (peer->outbox_head)
+        drop_outbox_head_locked(peer);
+
+    for (int lane = 0; lane < LANE_COUNT; lane++)
+    {
+        while (peer->inbox_head[lane])
+        {
+            InboundMessage *next = peer->inbox_head[lane]->next;
+            free(peer->inbox_head[lane]->owned);
+            free(peer->inbox_head[lane]);
+            peer->inbox_head[lane] = next;
+        }
+    }
+
+    // the descriptor is closed last so its number cannot be reused earlier
+    close(peer->socket);
+
+    free(peer->large_frame);
+    free(peer->ring);
+    pthread_mutex_destroy(&peer->lock);
+    free(peer);
+}
+
+// take a reference to the peer on a socket, NULL when it is gone
+static Peer *acquire_peer(int socket)
+{
+    Peer *peer = NULL;
+
+    pthread_mutex_lock(&peer_lock);
+
+    if (socket >= 0 && socket < MAX_PEERS && peers[socket])
+    {
+        peer = peers[socket];
+        peer->refs++;
     }
 
     pthread_mutex_unlock(&peer_lock);
+
+    return peer;
 }
 
-// update peer timestamp
-void update_peer_last_seen(int socket)
+static void release_peer(Peer *peer)
+{
+    pthread_mutex_lock(&peer_lock);
+    int last = --peer->refs == 0;
+    pthread_mutex_unlock(&peer_lock);
+
+    if (last)
+        free_peer(peer);
+}
+
+// epoll interest follows the peer state; called with peer->lock held
+static void update_interest_locked(Peer *peer)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+
+    event.events = (peer->paused ? 0 : EPOLLIN) |
+                   (peer->outbox_head ? EPOLLOUT : 0);
+    event.data.ptr = peer;
+
+    epoll_ctl(epoll_fds[peer->io_thread], EPOLL_CTL_MOD, peer->socket, &event);
+}
+
+// ask the owning I/O thread to drop the connection
+static void request_close_locked(Peer *peer)
+{
+    if (!peer->closing)
+    {
+        peer->closing = 1;
+        shutdown(peer->socket, SHUT_RDWR);
+    }
+}
+
+// disconnect and remove peer; only its I/O thread tears it down
+static void close_peer(Peer *peer)
 {
+    epoll_ctl(epoll_fds[peer->io_thread], EPOLL_CTL_DEL, peer->socket, NULL);
+
     pthread_mutex_lock(&peer_lock);
 
-    int index = find_peer_by_socket(socket);
-    if (index != -1)
+    if (peers[peer->socket] == peer)
     {
-        peers[index].last_seen = time(NULL);
+        peers[peer->socket] = NULL;
+        peer_count--;
     }
 
     pthread_mutex_unlock(&peer_lock);
+
+    pthread_mutex_lock(&peer->lock);
+    peer->closing = 1;
+    pthread_mutex_unlock(&peer->lock);
+
+    printf("[NETWORK] Peer %d disconnected.\n", peer->port);
+
+    release_peer(peer);
 }
 
-// process incoming message
-void handle_message(int client_socket, const char *message)
+// put a lane of the peer in the worker queue; the caller passes a
+// reference along
+static void schedule_peer(Peer *peer, int lane)
 {
-    update_peer_last_seen(client_socket);
-    protocol_dispatch(client_socket, message);
+    pthread_mutex_lock(&ready_lock);
+
+    peer->next_ready[lane] = NULL;
+
+    if (ready_tail[lane])
+        ready_tail[lane]->next_ready[lane] = peer;
+    else
+        ready_head[lane] = peer;
+
+    ready_tail[lane] = peer;
+
+    pthread_cond_signal(&ready_cond);
+    pthread_mutex_unlock(&ready_lock);
 }
 
-// handle client connection
-void *client_thread(void *arg)
+// hand a complete frame to the worker pool, keeping per-peer order within
+// its lane; only control messages are left in the ring, so the ring is
+// released in order even when slower lanes finish late
+static void enqueue_message(Peer *peer, int type, const char *payload,
+                            size_t len, char *owned)
 {
-    int client_socket = *(int *)arg;
-    free(arg);
+    int lane = protocol_lane(type);
 
-    char buffer[BUFFER_SIZE];
-    char message_buffer[BUFFER_SIZE];
-    int message_len = 0;
+    InboundMessage *message = malloc(sizeof(InboundMessage));
 
-    memset(message_buffer, 0, BUFFER_SIZE);
+    if (message && lane != LANE_CONTROL && !owned)
+    {
+        owned = malloc(len);
 
-    while (1)
+        if (owned)
+            memcpy(owned, payload, len);
+
+        payload = owned;
+    }
+
+    if (!message || !payload)
     {
-        int bytes = recv(client_socket, buffer, BUFFER_SIZE - 1, 0);
+        printf("[NETWORK] Out of memory, message from peer %d dropped.\n", peer->port);
+        free(message);
+        free(owned);
+        return;
+    }
 
-        // connection lost
-        if (bytes <= 0)
+    message->type = type;
+    message->payload = payload;
+    message->len = len;
+    message->owned = owned;
+    message->ring_end = peer->ring_parsed;
+    message->next = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &message->queued_at);
+
+    protocol_note_queued(type);
+
+    pthread_mutex_lock(&peer->lock);
+
+    if (peer->inbox_tail[lane])
+        peer->inbox_tail[lane]->next = message;
+    else
+        peer->inbox_head[lane] = message;
+
+    peer->inbox_tail[lane] = message;
+    peer->inbox_count++;
+
+    peer->ring_mark = peer->ring_parsed;
+
+    if (!owned)
+        peer->ring_pending++;
+    else if (peer->ring_pending == 0)
+        peer->ring_tail = peer->ring_mark;
+
+    // a peer sending faster than it is served waits in the kernel buffer
+    if (peer->inbox_count >= PEER_INBOX_MAX && !peer->paused)
+    {
+        peer->paused = 1;
+        update_interest_locked(peer);
+    }
+
+    int schedule = !peer->scheduled[lane];
+    peer->scheduled[lane] = 1;
+
+    pthread_mutex_unlock(&peer->lock);
+
+    if (schedule)
+    {
+        pthread_mutex_lock(&peer_lock);
+        peer->refs++;
+        pthread_mutex_unlock(&peer_lock);
+
+        schedule_peer(peer, lane);
+    }
+}
+
+// copy bytes out of the ring starting at a stream position
+static void ring_copy(const Peer *peer, size_t position, char *out, size_t len)
+{
+    size_t start = position & (RECV_RING_SIZE - 1);
+    size_t first = RECV_RING_SIZE - start < len ? RECV_RING_SIZE - start : len;
+
+    memcpy(out, peer->ring + start, first);
+    memcpy(out + first, peer->ring, len - first);
+}
+
+// the first frame settles the wire version and who the peer is
+static int accept_hello(Peer *peer, const char *payload, size_t len)
+{
+    int version;
+    int port;
+
+    if (!wire_parse_hello(payload, len, &version, &port))
+    {
+        printf("[NETWORK] Peer %d speaks no supported wire version.\n", peer->port);
+        return 0;
+    }
+
+    peer->wire_version = version;
+
+    // an inbound peer names its validator; dialed ones are known already
+    if (port > 0 && validator_slot(port) >= 0)
+    {
+        pthread_mutex_lock(&peer_lock);
+
+        if (peer->validator_port == 0)
+            peer->validator_port = port;
+
+        pthread_mutex_unlock(&peer_lock);
+    }
+
+    return 1;
+}
+
+// pass on a frame; 0 for a protocol violation
+static int deliver_frame(Peer *peer, int type, const char *payload,
+                         size_t len, char *owned)
+{
+    if (!peer->wire_version)
+    {
+        int ok = type == MSG_HELLO && accept_hello(peer, payload, len);
+
+        if (!ok)
+            printf("[NETWORK] Peer %d did not open with a hello.\n", peer->port);
+
+        free(owned);
+        return ok;
+    }
+
+    if (!wire_payload_valid(type, payload, len))
+    {
+        printf("[NETWORK] Malformed %s frame from peer %d.\n",
+               wire_type_name(type), peer->port);
+        free(owned);
+        return 0;
+    }
+
+    enqueue_message(peer, type, payload, len, owned);
+    return 1;
+}
+
+// cut complete frames out of the ring without copying them
+static int parse_frames(Peer *peer)
+{
+    while (peer->ring_head - peer->ring_parsed >= WIRE_HEADER_SIZE)
+    {
+        size_t available = peer->ring_head - peer->ring_parsed;
+        unsigned char header[WIRE_HEADER_SIZE];
+        int version;
+        int type;
+        size_t len;
+
+        ring_copy(peer, peer->ring_parsed, (char *)header, WIRE_HEADER_SIZE);
+
+        if (!wire_parse_header(header, &version, &type, &len) ||
+            len > MAX_MESSAGE_SIZE)
+        {
+            printf("[NETWORK] Invalid frame header from peer %d.\n", peer->port);
+            return 0;
+        }
+
+        // large frames continue straight into a buffer of their own
+        if (WIRE_HEADER_SIZE + len > LARGE_FRAME_MIN)
         {
-            if (bytes == 0)
+            char *frame = malloc(len);
+
+            if (!frame)
             {
-                printf("[NETWORK] Peer connection closed.\n");
+                printf("[NETWORK] Out of memory for a %zu byte frame.\n", len);
+                return 0;
             }
-            else
+
+            size_t prefix = available - WIRE_HEADER_SIZE < len
+                          ? available - WIRE_HEADER_SIZE : len;
+
+            ring_copy(peer, peer->ring_parsed + WIRE_HEADER_SIZE, frame, prefix);
+            peer->ring_parsed += WIRE_HEADER_SIZE + prefix;
+
+            if (prefix == len)
             {
-                printf("[NETWORK] Receive error on peer socket.\n");
+                if (!deliver_frame(peer, type, frame, len, frame))
+                    return 0;
+
+                continue;
             }
 
-            remove_peer(client_socket);
+            peer->large_frame = frame;
+            peer->large_len = len;
+            peer->large_got = prefix;
+            peer->large_type = type;
+            return 1;
+        }
+
+        if (available < WIRE_HEADER_SIZE + len)
             break;
+
+        size_t start = (peer->ring_parsed + WIRE_HEADER_SIZE) & (RECV_RING_SIZE - 1);
+        const char *payload = peer->ring + start;
+        char *owned = NULL;
+
+        // only a frame wrapping past the end of the ring is copied
+        if (start + len > RECV_RING_SIZE)
+        {
+            owned = malloc(len);
+
+            if (!owned)
+                return 0;
+
+            ring_copy(peer, peer->ring_parsed + WIRE_HEADER_SIZE, owned, len);
+            payload = owned;
         }
 
-        buffer[bytes] = '\0';
+        peer->ring_parsed += WIRE_HEADER_SIZE + len;
+
+        if (!deliver_frame(peer, type, payload, len, owned))
+            return 0;
+    }
+
+    return 1;
+}
+
+// receive the rest of a large frame in place
+static ssize_t read_large_frame(Peer *peer)
+{
+    ssize_t bytes = recv(peer->socket, peer->large_frame + peer->large_got,
+                         peer->large_len - peer->large_got, 0);
+
+    if (bytes <= 0)
+        return bytes;
+
+    peer->large_got += (size_t)bytes;
+
+    if (peer->large_got == peer->large_len)
+    {
+        char *frame = peer->large_frame;
+        peer->large_frame = NULL;
+
+        if (!deliver_frame(peer, peer->large_type, frame, peer->large_len, frame))
+            return -2;
+    }
+
+    return bytes;
+}
+
+// receive into the free part of the ring, both pieces when it wraps
+static ssize_t read_ring(Peer *peer)
+{
+    pthread_mutex_lock(&peer->lock);
+
+    size_t space = RECV_RING_SIZE - (peer->ring_head - peer->ring_tail);
 
-        for (int i = 0; i < bytes; i++)
+    // every byte is held by a message still being handled
+    if (space == 0)
+    {
+        peer->paused = 1;
+        update_interest_locked(peer);
+    }
+
+    pthread_mutex_unlock(&peer->lock);
+
+    if (space == 0)
+        return -3;
+
+    size_t start = peer->ring_head & (RECV_RING_SIZE - 1);
+    size_t first = RECV_RING_SIZE - start < space ? RECV_RING_SIZE - start : space;
+
+    struct iovec iov[2];
+    iov[0].iov_base = peer->ring + start;
+    iov[0].iov_len = first;
+    iov[1].iov_base = peer->ring;
+    iov[1].iov_len = space - first;
+
+    ssize_t bytes = readv(peer->socket, iov, space > first ? 2 : 1);
+
+    if (bytes <= 0)
+        return bytes;
+
+    peer->ring_head += (size_t)bytes;
+
+    return parse_frames(peer) ? bytes : -2;
+}
+
+// read what the socket has; 0 once the peer is gone
+static int read_peer(Peer *peer)
+{
+    // a bounded number of reads keeps one busy peer from starving the rest
+    for (int reads = 0; reads < 16; reads++)
+    {
+        ssize_t bytes = peer->large_frame ? read_large_frame(peer) : read_ring(peer);
+
+        if (bytes > 0)
         {
-            if (message_len < BUFFER_SIZE - 1)
-            {
-                message_buffer[message_len++] = buffer[i];
-            }
+            if (peer->paused)
+                return 1;
 
-            message_buffer[message_len] = '\0';
+            continue;
+        }
 
-            // block transmission complete
-            if (strstr(message_buffer, "~END_BLOCK~") != NULL)
-            {
-                handle_message(client_socket, message_buffer);
-                message_len = 0;
-                memset(message_buffer, 0, BUFFER_SIZE);
-                continue;
-            }
+        // ring full, resumed once workers release space
+        if (bytes == -3)
+            return 1;
+
+        // protocol violation, already reported
+        if (bytes == -2)
+            return 0;
+
+        if (bytes < 0 && errno == EINTR)
+            continue;
+
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 1;
+
+        // connection lost
+        if (bytes == 0)
+            printf("[NETWORK] Peer connection closed.\n");
+        else
+            printf("[NETWORK] Receive error on peer socket.\n");
+
+        return 0;
+    }
+
+    return 1;
+}
+
+// push as much of data as the socket takes; -1 on a broken connection
+static ssize_t send_some(int socket, const char *data, size_t len)
+{
+    size_t sent = 0;
+
+    while (sent < len)
+    {
+        ssize_t n = send(socket, data + sent, len - sent, MSG_NOSIGNAL);
+
+        if (n > 0)
+        {
+            sent += (size_t)n;
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        return -1;
+    }
+
+    return (ssize_t)sent;
+}
 
-            // single line message
-            if (buffer[i] == '\n')
+// write queued output, several messages per call; peer->lock held
+static void flush_peer_locked(Peer *peer)
+{
+    while (peer->outbox_head)
+    {
+        struct iovec iov[64];
+        int count = 0;
+
+        for (OutboundEntry *entry = peer->outbox_head; entry && count < 64; entry = entry->next)
+        {
+            size_t skip = count == 0 ? peer->head_sent : 0;
+
+            iov[count].iov_base = entry->buffer->data + skip;
+            iov[count].iov_len = entry->buffer->len - skip;
+            count++;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        ssize_t sent = sendmsg(peer->socket, &msg, MSG_NOSIGNAL);
+
+        if (sent < 0 && errno == EINTR)
+            continue;
+
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        if (sent < 0)
+        {
+            request_close_locked(peer);
+            return;
+        }
+
+        peer->last_progress = time(NULL);
+
+        // retire what went out completely
+        size_t left = (size_t)sent;
+
+        while (left > 0)
+        {
+            size_t remaining = peer->outbox_head->buffer->len - peer->head_sent;
+
+            if (left < remaining)
             {
-                handle_message(client_socket, message_buffer);
-                message_len = 0;
-                memset(message_buffer, 0, BUFFER_SIZE);
+                peer->head_sent += left;
+                peer->outbox_bytes -= left;
+                break;
             }
+
+            left -= remaining;
+            drop_outbox_head_locked(peer);
+        }
+    }
+
+    update_interest_locked(peer);
+}
+
+// evict a peer that cannot keep up instead of letting its queue grow
+static void evict_peer_locked(Peer *peer, const char *reason)
+{
+    printf("[NETWORK] Peer %d evicted: %s (%d messages, %zu bytes queued).\n",
+           peer->port, reason, peer->outbox_count, peer->outbox_bytes);
+
+    request_close_locked(peer);
+}
+
+// send now if nothing is queued ahead, else queue a reference to the buffer
+static void queue_output_locked(Peer *peer, SharedBuffer *buffer)
+{
+    const char *data = buffer->data;
+    size_t len = buffer->len;
+
+    if (peer->closing)
+        return;
+
+    size_t sent = 0;
+
+    if (!peer->outbox_head)
+    {
+        ssize_t n = send_some(peer->socket, data, len);
+
+        if (n < 0)
+        {
+            request_close_locked(peer);
+            return;
+        }
+
+        sent = (size_t)n;
+
+        if (sent == len)
+            return;
+
+        peer->last_progress = time(NULL);
+    }
+    else if (time(NULL) - peer->last_progress >= PEER_STALL_SECONDS)
+    {
+        evict_peer_locked(peer, "stalled");
+        return;
+    }
+
+    if (peer->outbox_bytes + (len - sent) > PEER_OUTBOX_MAX_BYTES ||
+        peer->outbox_count >= PEER_OUTBOX_MAX_MESSAGES)
+    {
+        evict_peer_locked(peer, "outbound queue full");
+        return;
+    }
+
+    OutboundEntry *entry = malloc(sizeof(OutboundEntry));
+
+    if (!entry)
+    {
+        evict_peer_locked(peer, "out of memory");
+        return;
+    }
+
+    shared_buffer_hold(buffer);
+
+    entry->buffer = buffer;
+    entry->next = NULL;
+
+    // the queue was empty, so a partial send only ever affects the head
+    if (!peer->outbox_head)
+        peer->head_sent = sent;
+
+    if (peer->outbox_tail)
+        peer->outbox_tail->next = entry;
+    else
+        peer->outbox_head = entry;
+
+    peer->outbox_tail = entry;
+    peer->outbox_bytes += len - sent;
+    peer->outbox_count++;
+
+    update_interest_locked(peer);
+}
+
+// process incoming message
+void handle_message(int client_socket, int type, const char *payload, size_t len,
+                    const struct timespec *queued_at)
+{
+    update_peer_last_seen(client_socket);
+    protocol_dispatch(client_socket, type, payload, len, queued_at);
+}
+
+// the control lane always goes first; the others, in priority order, may
+// only take NODE_BULK_WORKERS workers between them; -1 when nothing fits
+static int next_lane_locked()
+{
+    if (ready_head[LANE_CONTROL])
+        return LANE_CONTROL;
+
+    if (bulk_workers_busy >= NODE_BULK_WORKERS)
+        return -1;
+
+    for (int lane = LANE_CONTROL + 1; lane < LANE_COUNT; lane++)
+    {
+        if (ready_head[lane])
+            return lane;
+    }
+
+    return -1;
+}
+
+// run a batch of one peer lane's messages in arrival order
+static void serve_lane(Peer *peer, int lane)
+{
+    int handled = 0;
+
+    while (1)
+    {
+        pthread_mutex_lock(&peer->lock);
+
+        InboundMessage *message = peer->inbox_head[lane];
+
+        // a busy lane goes to the back of its queue with its reference
+        if (message && handled == WORKER_BATCH)
+        {
+            pthread_mutex_unlock(&peer->lock);
+            schedule_peer(peer, lane);
+            return;
+        }
+
+        if (!message)
+        {
+            peer->scheduled[lane] = 0;
+            pthread_mutex_unlock(&peer->lock);
+            break;
+        }
+
+        peer->inbox_head[lane] = message->next;
+
+        if (!peer->inbox_head[lane])
+            peer->inbox_tail[lane] = NULL;
+
+        int closing = peer->closing;
+
+        pthread_mutex_unlock(&peer->lock);
+
+        if (!closing)
+            handle_message(peer->socket, message->type, message->payload,
+                           message->len, &message->queued_at);
+
+        pthread_mutex_lock(&peer->lock);
+
+        peer->inbox_count--;
+
+        // ring messages all run on the control lane, so they finish in ring order
+        if (!message->owned)
+        {
+            peer->ring_pending--;
+            peer->ring_tail = peer->ring_pending ? message->ring_end : peer->ring_mark;
+        }
+
+        if (peer->paused && peer->inbox_count <= PEER_INBOX_MAX / 2)
+        {
+            peer->paused = 0;
+            update_interest_locked(peer);
+        }
+
+        pthread_mutex_unlock(&peer->lock);
+
+        free(message->owned);
+        free(message);
+        handled++;
+    }
+
+    release_peer(peer);
+}
+
+// take peer lanes off the ready queues, most urgent lane first
+static void *worker_thread(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&ready_lock);
+
+        int lane;
+
+        while ((lane = next_lane_locked()) < 0)
+            pthread_cond_wait(&ready_cond, &ready_lock);
+
+        Peer *peer = ready_head[lane];
+        ready_head[lane] = peer->next_ready[lane];
+
+        if (!ready_head[lane])
+            ready_tail[lane] = NULL;
+
+        if (lane != LANE_CONTROL)
+            bulk_workers_busy++;
+
+        pthread_mutex_unlock(&ready_lock);
+
+        serve_lane(peer, lane);
+
+        if (lane != LANE_CONTROL)
+        {
+            // a bulk lane held back by the limit may go now
+            pthread_mutex_lock(&ready_lock);
+            bulk_workers_busy--;
+            pthread_cond_signal(&ready_cond);
+            pthread_mutex_unlock(&ready_lock);
         }
     }
 
     return NULL;
 }
 
-// start listening for peers
-void start_server(int port)
+// make a peer for a connected socket and hand it to an I/O thread
+static int register_peer(int socket, int port, int validator_port)
 {
-    int server_fd;
-    struct sockaddr_in address, client_addr;
+    if (socket >= MAX_PEERS)
+    {
+        printf("[NETWORK] Connection limit reached, peer %d refused.\n", port);
+        close(socket);
+        return 0;
+    }
+
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
 
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0)
+    Peer *peer = calloc(1, sizeof(Peer));
+    char *ring = malloc(RECV_RING_SIZE);
+
+    if (!peer || !ring)
     {
-        printf("[NETWORK] Failed to create server socket.\n");
-        exit(EXIT_FAILURE);
+        free(peer);
+        free(ring);
+        close(socket);
+        return 0;
     }
 
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    peer->socket = socket;
+    peer->port = port;
+    peer->validator_port = validator_port;
+    peer->last_seen = time(NULL);
+    peer->io_thread = socket % NODE_IO_THREADS;
+    peer->refs = 2;       // the table's and ours until the hello is queued
+    peer->ring = ring;
+    pthread_mutex_init(&peer->lock, NULL);
 
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
+    pthread_mutex_lock(&peer_lock);
+    peers[socket] = peer;
+    peer_count++;
+    pthread_mutex_unlock(&peer_lock);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = peer;
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    if (epoll_ctl(epoll_fds[peer->io_thread], EPOLL_CTL_ADD, socket, &event) < 0)
     {
-        printf("[NETWORK] Failed to bind to port %d.\n", port);
-        exit(EXIT_FAILURE);
+        pthread_mutex_lock(&peer_lock);
+        peers[socket] = NULL;
+        peer_count--;
+        pthread_mutex_unlock(&peer_lock);
+
+        // the table's reference and ours
+        release_peer(peer);
+        release_peer(peer);
+        return 0;
     }
 
-    if (listen(server_fd, 10) < 0)
+    // both ends open with a hello naming their versions and validator port
+    size_t hello_len = 0;
+    char *hello_frame = wire_hello_frame(local_port, &hello_len);
+    SharedBuffer *hello = shared_buffer_wrap(hello_frame, hello_len);
+
+    if (hello)
     {
-        printf("[NETWORK] Failed to start listening on port %d.\n", port);
-        exit(EXIT_FAILURE);
+        pthread_mutex_lock(&peer->lock);
+        queue_output_locked(peer, hello);
+        pthread_mutex_unlock(&peer->lock);
+
+        shared_buffer_release(hello);
     }
 
-    printf("[NETWORK] Node listening on port %d\n", port);
+    // the I/O thread may already have dropped a peer that hung up at once
+    release_peer(peer);
+    return 1;
+}
 
+// take every pending inbound connection
+static void accept_peers()
+{
     while (1)
     {
-        int *client_socket = malloc(sizeof(int));
+        struct sockaddr_in client_addr;
         socklen_t addrlen = sizeof(client_addr);
 
-        *client_socket = accept(server_fd,
-                                (struct sockaddr *)&client_addr,
-                                &addrlen);
+        int client_socket = accept(listen_socket,
+                                   (struct sockaddr *)&client_addr,
+                                   &addrlen);
 
-        if (*client_socket < 0)
+        if (client_socket < 0)
         {
-            free(client_socket);
-            continue;
+            if (errno == EINTR)
+                continue;
+
+            return;
         }
 
-        pthread_mutex_lock(&peer_lock);
+        int port = ntohs(client_addr.sin_port);
+
+        if (register_peer(client_socket, port, 0))
+            printf("[NETWORK] Inbound connection accepted (remote port %d)\n", port);
+    }
+}
+
+// wait for socket events on one epoll set
+static void *io_thread(void *arg)
+{
+    int epoll_fd = epoll_fds[*(int *)arg];
+    free(arg);
+
+    struct epoll_event events[64];
 
-        for (int i = 0; i < MAX_PEERS; i++)
+    while (1)
+    {
+        int ready = epoll_wait(epoll_fd, events, 64, -1);
+
+        for (int i = 0; i < ready; i++)
         {
-            if (!peers[i].active)
+            // the listening socket is registered without a peer
+            if (events[i].data.ptr == NULL)
             {
-                peers[i].socket = *client_socket;
-                peers[i].port = ntohs(client_addr.sin_port);
-                peers[i].last_seen = time(NULL);
-                peers[i].active = 1;
-                peer_count++;
+                accept_peers();
+                continue;
+            }
 
-                printf("[NETWORK] Inbound connection accepted (remote port %d)\n",
-                       peers[i].port);
+            Peer *peer = events[i].data.ptr;
+            int alive = 1;
 
-                break;
+            if (events[i].events & EPOLLOUT)
+            {
+                pthread_mutex_lock(&peer->lock);
+                flush_peer_locked(peer);
+                pthread_mutex_unlock(&peer->lock);
             }
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                alive = read_peer(peer);
+
+            pthread_mutex_lock(&peer->lock);
+            int closing = peer->closing;
+            pthread_mutex_unlock(&peer->lock);
+
+            if (!alive || closing)
+                close_peer(peer);
         }
+    }
 
-        pthread_mutex_unlock(&peer_lock);
+    return NULL;
+}
+
+// create the epoll sets, I/O threads and workers once per process
+static void init_node()
+{
+    for (int i = 0; i < NODE_IO_THREADS; i++)
+    {
+        epoll_fds[i] = epoll_create1(0);
+
+        if (epoll_fds[i] < 0)
+        {
+            printf("[NETWORK] Failed to create epoll instance.\n");
+            return;
+        }
+    }
+
+    for (int i = 0; i < NODE_IO_THREADS; i++)
+    {
+        pthread_t thread_id;
+        int *index = malloc(sizeof(int));
+
+        if (!index)
+            return;
+
+        *index = i;
+
+        if (pthread_create(&thread_id, NULL, io_thread, index) != 0)
+        {
+            free(index);
+            return;
+        }
+
+        pthread_detach(thread_id);
+    }
 
+    for (int i = 0; i < NODE_WORKER_THREADS; i++)
+    {
         pthread_t thread_id;
-        pthread_create(&thread_id, NULL, client_thread, client_socket);
+
+        if (pthread_create(&thread_id, NULL, worker_thread, NULL) != 0)
+            return;
+
         pthread_detach(thread_id);
     }
+
+    node_ready = 1;
+}
+
+// start listening for peers; accepted sockets are served by the I/O threads
+void start_server(int port)
+{
+    pthread_once(&node_once, init_node);
+
+    if (!node_ready)
+    {
+        printf("[NETWORK] Network threads unavailable.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_in address;
+
+    listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_socket < 0)
+    {
+        printf("[NETWORK] Failed to create server socket.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int opt = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(listen_socket, (struct sockaddr *)&address, sizeof(address)) < 0)
+    {
+        printf("[NETWORK] Failed to bind to port %d.\n", port);
+        exit(EXIT_FAILURE);
+    }
+
+    if (listen(listen_socket, SOMAXCONN) < 0)
+    {
+        printf("[NETWORK] Failed to start listening on port %d.\n", port);
+        exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+
+    if (epoll_ctl(epoll_fds[0], EPOLL_CTL_ADD, listen_socket, &event) < 0)
+    {
+        printf("[NETWORK] Failed to watch port %d.\n", port);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("[NETWORK] Node listening on port %d\n", port);
 }
 
 // connect to a remote peer
 void connect_to_peer(const char *ip, int port)
 {
+    pthread_once(&node_once, init_node);
+
+    if (!node_ready)
+        return;
+
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0)
         return;
 
     struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(port);
 
@@ -222,52 +1183,133 @@ void connect_to_peer(const char *ip, int port)
         return;
     }
 
+    // the connect itself blocks; the socket turns non-blocking once registered
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
     {
         close(sock);
         return;
     }
 
+    if (!register_peer(sock, port, port))
+        return;
+
+    printf("[NETWORK] Outbound connection established to peer %d\n", port);
+}
+
+// queue a prebuilt frame for one peer
+void send_buffer(int socket, SharedBuffer *frame)
+{
+    Peer *peer = acquire_peer(socket);
+
+    if (!peer)
+        return;
+
+    pthread_mutex_lock(&peer->lock);
+    queue_output_locked(peer, frame);
+    pthread_mutex_unlock(&peer->lock);
+
+    release_peer(peer);
+}
+
+// frame a text payload, terminator included, for one peer
+void send_text(int socket, int type, const char *text)
+{
+    size_t frame_len = 0;
+    char *data = wire_text_frame(type, text, &frame_len);
+    SharedBuffer *frame = shared_buffer_wrap(data, frame_len);
+
+    if (frame)
+    {
+        send_buffer(socket, frame);
+        shared_buffer_release(frame);
+    }
+}
+
+// queue one shared message on every peer; returns the peers it reached
+int broadcast_buffer(SharedBuffer *buffer)
+{
+    int reached = 0;
+
     pthread_mutex_lock(&peer_lock);
 
     for (int i = 0; i < MAX_PEERS; i++)
     {
-        if (!peers[i].active)
+        if (peers[i])
         {
-            peers[i].socket = sock;
-            peers[i].port = port;
-            peers[i].last_seen = time(NULL);
-            peers[i].active = 1;
-            peer_count++;
-            break;
+            pthread_mutex_lock(&peers[i]->lock);
+
+            queue_output_locked(peers[i], buffer);
+            reached += !peers[i]->closing;
+
+            pthread_mutex_unlock(&peers[i]->lock);
         }
     }
 
     pthread_mutex_unlock(&peer_lock);
 
-    printf("[NETWORK] Outbound connection established to peer %d\n", port);
+    return reached;
+}
+
+// frame a text payload once and send it to all peers
+void broadcast_text(int type, const char *text)
+{
+    size_t frame_len = 0;
+    char *data = wire_text_frame(type, text, &frame_len);
+    SharedBuffer *frame = shared_buffer_wrap(data, frame_len);
 
-    pthread_t thread_id;
-    int *socket_ptr = malloc(sizeof(int));
-    *socket_ptr = sock;
-    pthread_create(&thread_id, NULL, client_thread, socket_ptr);
-    pthread_detach(thread_id);
+    if (frame)
+    {
+        broadcast_buffer(frame);
+        shared_buffer_release(frame);
+    }
 }
 
-// send message to all peers
-void broadcast_message(const char *message)
+// is any peer far enough behind that new blocks should wait; stalled
+// peers are evicted here too, since a waiting producer queues nothing new
+int outbound_backlogged()
 {
+    int backlogged = 0;
+    time_t now = time(NULL);
+
     pthread_mutex_lock(&peer_lock);
 
     for (int i = 0; i < MAX_PEERS; i++)
     {
-        if (peers[i].active)
-        {
-            send(peers[i].socket, message, strlen(message), 0);
-        }
+        Peer *peer = peers[i];
+
+        if (!peer)
+            continue;
+
+        pthread_mutex_lock(&peer->lock);
+
+        if (!peer->closing && peer->outbox_head &&
+            now - peer->last_progress >= PEER_STALL_SECONDS)
+            evict_peer_locked(peer, "stalled");
+
+        if (!peer->closing && peer->outbox_bytes > PEER_OUTBOX_HIGH_WATER)
+            backlogged = 1;
+
+        pthread_mutex_unlock(&peer->lock);
     }
 
     pthread_mutex_unlock(&peer_lock);
+
+    return backlogged;
+}
+
+// update peer timestamp
+void update_peer_last_seen(int socket)
+{
+    Peer *peer = acquire_peer(socket);
+
+    if (!peer)
+        return;
+
+    pthread_mutex_lock(&peer->lock);
+    peer->last_seen = time(NULL);
+    pthread_mutex_unlock(&peer->lock);
+
+    release_peer(peer);
 }
 
 // active peer count
@@ -278,3 +1320,8 @@ int get_peer_count()
     pthread_mutex_unlock(&peer_lock);
     return count;
 }
+
+void set_local_port(int port)
+{
+    local_port = port;
+}
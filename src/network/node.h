@@ -1,23 +1,65 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <stddef.h>
 #include <time.h>
+#include <pthread.h>
 
-#define MAX_PEERS 50
-#define BUFFER_SIZE 2048
+// connections are indexed by socket, so this also caps descriptor numbers
+#define MAX_PEERS 1024
 
+// largest single frame payload a peer may send, enough for a full block
+#define MAX_MESSAGE_SIZE (4 * 1024 * 1024)
+
+// epoll threads doing socket I/O and workers running the protocol
+#define NODE_IO_THREADS 2
+#define NODE_WORKER_THREADS 4
+
+// workers the block and serving lanes may hold at once, leaving the rest
+// free for votes and heights; at least one
+#define NODE_BULK_WORKERS (NODE_WORKER_THREADS - 1)
+
+// per-connection receive ring, a power of two; frames up to half of it are
+// handed to workers in place, larger ones get a buffer of their own
+#define RECV_RING_SIZE (64 * 1024)
+#define LARGE_FRAME_MIN (RECV_RING_SIZE / 2)
+
+// a peer stops being read while this many of its messages wait for a worker
+#define PEER_INBOX_MAX 256
+
+// messages a worker handles for one peer before moving to the next
+#define WORKER_BATCH 16
+
+// unsent output a peer may hold before it is evicted as too slow
+#define PEER_OUTBOX_MAX_BYTES (32 * 1024 * 1024)
+#define PEER_OUTBOX_MAX_MESSAGES 4096
+
+// above this, block production waits for peers to catch up
+#define PEER_OUTBOX_HIGH_WATER (PEER_OUTBOX_MAX_BYTES / 4)
+
+// a peer whose queue has not moved for this long is evicted
+#define PEER_STALL_SECONDS 15
+
+// a framed message shared by every peer queue sending it
 typedef struct {
-    int socket;
-    int port;
-    time_t last_seen;
-    int active;
-} Peer;
+    char *data;
+    size_t len;
+    int refs;
+    pthread_mutex_t lock;
+} SharedBuffer;
+
+SharedBuffer *shared_buffer_wrap(char *data, size_t len);
+void shared_buffer_release(SharedBuffer *buffer);
 
 void start_server(int port);
 void connect_to_peer(const char *ip, int port);
-void broadcast_message(const char *message);
-void send_message(int socket, const char *message);
+void broadcast_text(int type, const char *text);
+int broadcast_buffer(SharedBuffer *buffer);
+int outbound_backlogged();
+void send_text(int socket, int type, const char *text);
+void send_buffer(int socket, SharedBuffer *frame);
 int get_peer_count();
 void update_peer_last_seen(int socket);
+void set_local_port(int port);
 
 #endif
@@ -1,112 +1,674 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "proposal.h"
 #include "serializer.h"
 #include "node.h"
 #include "../blockchain/blockchain.h"
+#include "../blockchain/quorum.h"
 
 // proposal state management
 
-static Block current_proposal;
-static int proposal_active = 0;
-static int approve_votes = 0;
+// one block this node proposed and is collecting votes for
+typedef struct {
+    Block block;
+    int active;
+    int decided;          // quorum reached, waiting for its turn to commit
+    unsigned char voters[VOTER_BITMAP_SIZE];
+    QuorumCertificate qc;
+    time_t proposed_at;
+} ProposalSlot;
+
+static ProposalSlot proposals[PIPELINE_DEPTH_MAX];
+static int pipeline_depth = PIPELINE_DEPTH_DEFAULT;
 static pthread_mutex_t vote_lock = PTHREAD_MUTEX_INITIALIZER;
 
+// proposals from other leaders this node voted for, so a pipelined
+// successor can name one of them as its parent
+typedef struct {
+    int index;
+    Digest hash;
+    time_t approved_at;
+    int active;
+} ApprovedProposal;
 
-// initiate block proposal
-void propose_block(Block *block)
+static ApprovedProposal approved[PIPELINE_DEPTH_MAX];
+static pthread_mutex_t approved_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// committed blocks that arrived ahead of their predecessor, with the
+// certificates that already passed verification
+static Block pending_commits[PIPELINE_DEPTH_MAX];
+static QuorumCertificate pending_qcs[PIPELINE_DEPTH_MAX];
+static int pending_commit_used[PIPELINE_DEPTH_MAX];
+static pthread_mutex_t commit_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// key this node signs its votes with
+static Signer *vote_signer = NULL;
+static int vote_port = 0;
+
+
+void set_validator_identity(Signer *signer, int port)
 {
-    pthread_mutex_lock(&vote_lock);
+    vote_signer = signer;
+    vote_port = port;
 
-    current_proposal = *block;
-    proposal_active = 1;
+    set_local_port(port);
+}
 
-    // local vote counts
-    approve_votes = 1;
+int get_validator_port()
+{
+    return vote_port;
+}
+
+// sign the approval statement for a block
+int sign_vote(int index, const Digest *block_hash, char signature[HASH_SIZE])
+{
+    if (!vote_signer)
+        return 0;
+
+    char message[VOTE_MESSAGE_SIZE];
+    vote_message(index, block_hash, message);
+
+    return signer_sign(vote_signer, message, signature);
+}
+
+
+// set how many proposals may be in flight at once
+void set_pipeline_depth(int depth)
+{
+    if (depth < 1)
+        depth = 1;
 
+    if (depth > PIPELINE_DEPTH_MAX)
+        depth = PIPELINE_DEPTH_MAX;
+
+    pthread_mutex_lock(&vote_lock);
+    pipeline_depth = depth;
     pthread_mutex_unlock(&vote_lock);
+}
 
-    char buffer[SERIALIZED_BLOCK_SIZE];
-    char message[SERIALIZED_BLOCK_SIZE + 32];
+int get_pipeline_depth()
+{
+    pthread_mutex_lock(&vote_lock);
+    int depth = pipeline_depth;
+    pthread_mutex_unlock(&vote_lock);
 
-    serialize_block(block, buffer);
+    return depth;
+}
 
-    snprintf(message, sizeof(message),
-             "PROPOSE_BLOCK:%s\n", buffer);
+static void drop_slot_locked(ProposalSlot *slot)
+{
+    free_block(&slot->block);
+    slot->active = 0;
+    slot->decided = 0;
+}
 
-    printf("[CONSENSUS] Broadcasting proposal for block %d\n",
-           block->index);
+static ProposalSlot *find_slot_locked(int index, const Digest *hash)
+{
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (proposals[i].active &&
+            proposals[i].block.index == index &&
+            (!hash || digest_equal(&proposals[i].block.block_hash, hash)))
+            return &proposals[i];
+    }
 
-    broadcast_message(message);
+    return NULL;
 }
 
+// drop proposals that can no longer extend the chain: those overtaken by
+// committed blocks and every descendant of a dropped proposal
+static void prune_proposals_locked()
+{
+    int height = get_blockchain_height();
+
+    Digest tip_hash;
+    if (!get_last_block_hash(&tip_hash))
+        return;
+
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (proposals[i].active &&
+            (proposals[i].block.index < height ||
+             proposals[i].block.index >= height + PIPELINE_DEPTH_MAX))
+        {
+            printf("[CONSENSUS] Proposal for block %d superseded.\n",
+                   proposals[i].block.index);
+            drop_slot_locked(&proposals[i]);
+        }
+    }
+
+    // ascending index order, so parents are settled before their children
+    for (int index = height; index < height + PIPELINE_DEPTH_MAX; index++)
+    {
+        for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+        {
+            ProposalSlot *slot = &proposals[i];
+
+            if (!slot->active || slot->block.index != index)
+                continue;
+
+            int linked;
+
+            if (index == height)
+                linked = digest_equal(&slot->block.previous_hash, &tip_hash);
+            else
+                linked = find_slot_locked(index - 1, &slot->block.previous_hash) != NULL;
+
+            if (!linked)
+            {
+                printf("[CONSENSUS] Proposal for block %d dropped (stale parent).\n",
+                       index);
+                drop_slot_locked(slot);
+            }
+        }
+    }
+}
+
+// commit decided proposals strictly in index order
+static void commit_ready_locked()
+{
+    prune_proposals_locked();
+
+    while (1)
+    {
+        int height = get_blockchain_height();
+        ProposalSlot *slot = NULL;
+
+        for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+        {
+            if (proposals[i].active && proposals[i].decided &&
+                proposals[i].block.index == height)
+            {
+                slot = &proposals[i];
+                break;
+            }
+        }
+
+        if (!slot)
+            break;
+
+        // a remote commit may have taken this height meanwhile
+        if (!add_block(&slot->block))
+        {
+            drop_slot_locked(slot);
+            continue;
+        }
+
+        store_quorum_certificate(&slot->qc);
+
+        // serialized once, every peer queue shares the buffer
+        size_t frame_len = 0;
+        char *frame = serialize_commit_frame(&slot->block, &slot->qc, &frame_len);
+        SharedBuffer *message = shared_buffer_wrap(frame, frame_len);
+
+        if (message)
+        {
+            broadcast_buffer(message);
+            shared_buffer_release(message);
+        }
+
+        printf("[CONSENSUS] Block %d committed\n", slot->block.index);
+
+        drop_slot_locked(slot);
+    }
+}
+
+
+// initiate block proposal; returns 0 when the pipeline is full
+int propose_block(Block *block)
+{
+    // the leader's own signed vote opens the certificate
+    char signature[HASH_SIZE];
+    int own_slot = validator_slot(vote_port);
+
+    if (own_slot < 0 || !sign_vote(block->index, &block->block_hash, signature))
+    {
+        printf("[CRYPTO] Vote for block %d could not be signed.\n", block->index);
+        return 0;
+    }
 
-// count incoming votes
+    size_t frame_len = 0;
+    char *frame = serialize_block_frame(MSG_PROPOSE_BLOCK, block, &frame_len);
+    SharedBuffer *message = shared_buffer_wrap(frame, frame_len);
+
+    if (!message)
+    {
+        printf("[CONSENSUS] Block %d could not be serialized.\n", block->index);
+        return 0;
+    }
+
+    pthread_mutex_lock(&vote_lock);
+
+    int in_flight = 0;
+    ProposalSlot *slot = NULL;
+
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (proposals[i].active)
+            in_flight++;
+        else if (!slot)
+            slot = &proposals[i];
+    }
+
+    if (in_flight >= pipeline_depth || !slot ||
+        find_slot_locked(block->index, NULL))
+    {
+        pthread_mutex_unlock(&vote_lock);
+        shared_buffer_release(message);
+        printf("[CONSENSUS] Block %d not proposed: pipeline busy.\n", block->index);
+        return 0;
+    }
+
+    // the proposal keeps its own copy of the transactions
+    if (!copy_block(&slot->block, block))
+    {
+        free_block(&slot->block);
+        pthread_mutex_unlock(&vote_lock);
+        shared_buffer_release(message);
+        printf("[CONSENSUS] Block %d could not be copied.\n", block->index);
+        return 0;
+    }
+
+    slot->active = 1;
+    slot->decided = 0;
+    slot->proposed_at = time(NULL);
+
+    // local vote counts
+    memset(slot->voters, 0, sizeof(slot->voters));
+    SET_VOTER_BIT(slot->voters, own_slot);
+
+    quorum_init(&slot->qc, block->index, &block->block_hash);
+    quorum_add_vote(&slot->qc, vote_port, signature);
+
+    printf("[CONSENSUS] Broadcasting proposal for block %d (%d transactions, %d in flight)\n",
+           block->index, block->transaction_count, in_flight + 1);
+
+    // broadcast under the lock so proposals leave in index order; peers
+    // share the one serialized buffer
+    broadcast_buffer(message);
+
+    pthread_mutex_unlock(&vote_lock);
+
+    shared_buffer_release(message);
+    return 1;
+}
+
+
+// count a signed approval: APPROVE|index|hash|port|signature; each
+// registered validator counts once per proposal
 void register_vote(const char *vote)
 {
+    if (strncmp(vote, "APPROVE|", 8) != 0)
+        return;
+
+    int index;
+    int port;
+    int consumed = 0;
+    char hash_hex[DIGEST_HEX_SIZE];
+
+    if (sscanf(vote + 8, "%d|%64[0-9a-fA-F]|%d|%n",
+               &index, hash_hex, &port, &consumed) != 3 || consumed == 0)
+        return;
+
+    const char *signature = vote + 8 + consumed;
+
+    Digest hash;
+    if (!digest_from_hex(hash_hex, hash.bytes) || strlen(signature) >= HASH_SIZE)
+        return;
+
+    int voter = validator_slot(port);
+
+    if (voter < 0)
+    {
+        printf("[CONSENSUS] Vote from unregistered validator %d ignored.\n", port);
+        return;
+    }
+
+    // skip votes already counted before paying for a signature check
     pthread_mutex_lock(&vote_lock);
 
-    if (!proposal_active)
+    ProposalSlot *slot = find_slot_locked(index, &hash);
+    int fresh = slot && !slot->decided && !VOTER_BIT(slot->voters, voter);
+
+    pthread_mutex_unlock(&vote_lock);
+
+    if (!fresh)
+        return;
+
+    char message[VOTE_MESSAGE_SIZE];
+    char public_key_path[64];
+
+    vote_message(index, &hash, message);
+    snprintf(public_key_path, sizeof(public_key_path),
+             VALIDATOR_KEY_DIR "/%d_public.pem", port);
+
+    if (!verify_signature(message, public_key_path, signature))
+    {
+        printf("[CRYPTO] Vote for block %d from validator %d INVALID.\n", index, port);
+        return;
+    }
+
+    printf("[CONSENSUS] Vote received: block %d approved by validator %d\n", index, port);
+
+    pthread_mutex_lock(&vote_lock);
+
+    // the proposal may have been decided or dropped while verifying
+    slot = find_slot_locked(index, &hash);
+
+    if (!slot || slot->decided || VOTER_BIT(slot->voters, voter))
     {
         pthread_mutex_unlock(&vote_lock);
         return;
     }
 
-    if (strstr(vote, "APPROVE"))
+    SET_VOTER_BIT(slot->voters, voter);
+    quorum_add_vote(&slot->qc, port, signature);
+
+    if (slot->qc.vote_count >= quorum_required())
     {
-        approve_votes++;
+        printf("[CONSENSUS] Quorum reached for block %d (%d votes)\n",
+               slot->block.index, slot->qc.vote_count);
+
+        slot->decided = 1;
+        commit_ready_locked();
     }
 
-    int total_nodes = get_peer_count() + 1;
-    int majority = (total_nodes / 2) + 1;
+    pthread_mutex_unlock(&vote_lock);
+}
+
+
+// drop the oldest undecided proposals that ran out of time
+void expire_proposals()
+{
+    time_t now = time(NULL);
+    int expired = 0;
+
+    pthread_mutex_lock(&vote_lock);
+
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (proposals[i].active && !proposals[i].decided &&
+            now - proposals[i].proposed_at >= PROPOSAL_TIMEOUT_SEC)
+        {
+            printf("[CONSENSUS] Proposal for block %d expired.\n",
+                   proposals[i].block.index);
+            drop_slot_locked(&proposals[i]);
+            expired = 1;
+        }
+    }
+
+    // descendants of an expired proposal cannot commit either
+    if (expired)
+        commit_ready_locked();
+
+    pthread_mutex_unlock(&vote_lock);
+}
+
+int proposals_in_flight()
+{
+    int in_flight = 0;
+
+    pthread_mutex_lock(&vote_lock);
 
-    if (approve_votes >= majority)
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
     {
-        printf("[CONSENSUS] Majority reached for block %d\n",
-               current_proposal.index);
+        if (proposals[i].active)
+            in_flight++;
+    }
 
-        add_block(&current_proposal);
+    pthread_mutex_unlock(&vote_lock);
 
-        char buffer[SERIALIZED_BLOCK_SIZE];
-        char message[SERIALIZED_BLOCK_SIZE + 32];
+    return in_flight;
+}
 
-        serialize_block(&current_proposal, buffer);
+// is the proposal still collecting votes or waiting to commit
+int proposal_pending(int index, const Digest *hash)
+{
+    pthread_mutex_lock(&vote_lock);
+    int pending = find_slot_locked(index, hash) != NULL;
+    pthread_mutex_unlock(&vote_lock);
 
-        snprintf(message, sizeof(message),
-                 "COMMIT_BLOCK:%s\n", buffer);
+    return pending;
+}
 
-        broadcast_message(message);
+// block the next proposal builds on: the newest in flight, else the chain tip
+int proposal_tip(int *index, Digest *hash)
+{
+    pthread_mutex_lock(&vote_lock);
 
-        printf("[CONSENSUS] Block %d committed\n",
-               current_proposal.index);
+    ProposalSlot *newest = NULL;
 
-        proposal_active = 0;
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (proposals[i].active &&
+            (!newest || proposals[i].block.index > newest->block.index))
+            newest = &proposals[i];
+    }
+
+    int found = 1;
+
+    if (newest)
+    {
+        *index = newest->block.index;
+        *hash = newest->block.block_hash;
+    }
+    else
+    {
+        *index = get_blockchain_height() - 1;
+        found = get_last_block_hash(hash);
     }
 
     pthread_mutex_unlock(&vote_lock);
+
+    return found;
+}
+
+
+// a proposal may extend the chain tip or a proposal this node approved
+int proposal_parent_known(const Block *block)
+{
+    int height = get_blockchain_height();
+
+    if (block->index == height)
+    {
+        Digest tip_hash;
+        return get_last_block_hash(&tip_hash) &&
+               digest_equal(&block->previous_hash, &tip_hash);
+    }
+
+    if (block->index < height || block->index > height + PIPELINE_DEPTH_MAX)
+        return 0;
+
+    time_t now = time(NULL);
+    int known = 0;
+
+    pthread_mutex_lock(&approved_lock);
+
+    for (int i = 0; i < PIPELINE_DEPTH_MAX && !known; i++)
+    {
+        known = approved[i].active &&
+                now - approved[i].approved_at < PROPOSAL_TIMEOUT_SEC &&
+                approved[i].index == block->index - 1 &&
+                digest_equal(&approved[i].hash, &block->previous_hash);
+    }
+
+    pthread_mutex_unlock(&approved_lock);
+
+    return known;
+}
+
+// remember an approved proposal, reusing the oldest or a settled entry
+void note_approved_proposal(const Block *block)
+{
+    int height = get_blockchain_height();
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&approved_lock);
+
+    ApprovedProposal *entry = &approved[0];
+
+    for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+    {
+        if (approved[i].active &&
+            (approved[i].index < height ||
+             now - approved[i].approved_at >= PROPOSAL_TIMEOUT_SEC))
+            approved[i].active = 0;
+
+        if (!approved[i].active)
+        {
+            entry = &approved[i];
+            break;
+        }
+
+        if (approved[i].approved_at < entry->approved_at)
+            entry = &approved[i];
+    }
+
+    entry->index = block->index;
+    entry->hash = block->block_hash;
+    entry->approved_at = now;
+    entry->active = 1;
+
+    pthread_mutex_unlock(&approved_lock);
+}
+
+
+// append the block if it extends the tip; 0 when it does not
+static int commit_if_next_locked(Block *block, const QuorumCertificate *qc)
+{
+    Digest tip_hash;
+
+    if (block->index != get_blockchain_height() ||
+        !get_last_block_hash(&tip_hash) ||
+        !digest_equal(&block->previous_hash, &tip_hash))
+        return 0;
+
+    printf("[CONSENSUS] Committing received block %d\n", block->index);
+
+    // a local quorum commit may have taken this height meanwhile
+    if (!add_block(block))
+        return 0;
+
+    store_quorum_certificate(qc);
+    return 1;
 }
 
+// apply buffered commits that now follow the tip
+static void drain_pending_commits_locked()
+{
+    int progressed = 1;
+
+    while (progressed)
+    {
+        progressed = 0;
+        int height = get_blockchain_height();
+
+        for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+        {
+            if (!pending_commit_used[i])
+                continue;
+
+            if (pending_commits[i].index < height)
+            {
+                free_block(&pending_commits[i]);
+                pending_commit_used[i] = 0;
+            }
+            else if (commit_if_next_locked(&pending_commits[i], &pending_qcs[i]))
+            {
+                free_block(&pending_commits[i]);
+                pending_commit_used[i] = 0;
+                progressed = 1;
+                break;
+            }
+        }
+    }
+}
 
-// finalize block commit
-void handle_commit(const char *serialized)
+// finalize block commit; the quorum certificate stands in for re-verifying
+// the block, and pipelined commits may arrive out of order
+void handle_commit(const char *payload, size_t len)
 {
+    QuorumCertificate qc;
     Block incoming;
     memset(&incoming, 0, sizeof(Block));
 
-    if (!deserialize_block(serialized, &incoming))
+    if (!deserialize_commit(payload, len, &qc, &incoming))
+    {
+        printf("[CONSENSUS] Malformed commit ignored.\n");
         return;
+    }
 
-    if (block_exists_by_index(incoming.index))
+    if (incoming.index < get_blockchain_height())
     {
         printf("[CONSENSUS] Duplicate commit ignored for block %d\n",
                incoming.index);
+        free_block(&incoming);
         return;
     }
 
-    printf("[CONSENSUS] Committing received block %d\n",
-           incoming.index);
+    if (!quorum_verify(&qc, &incoming))
+    {
+        printf("[CONSENSUS] Commit for block %d rejected: Quorum certificate invalid.\n",
+               incoming.index);
+        free_block(&incoming);
+        return;
+    }
+
+    pthread_mutex_lock(&commit_lock);
+
+    int height = get_blockchain_height();
+
+    if (incoming.index < height)
+    {
+        printf("[CONSENSUS] Duplicate commit ignored for block %d\n",
+               incoming.index);
+        free_block(&incoming);
+    }
+    else if (incoming.index == height)
+    {
+        if (commit_if_next_locked(&incoming, &qc))
+            drain_pending_commits_locked();
+        else
+            printf("[CONSENSUS] Commit for block %d does not extend the chain.\n",
+                   incoming.index);
+
+        free_block(&incoming);
+    }
+    else
+    {
+        // hold it until its predecessor lands
+        int slot = -1;
+
+        for (int i = 0; i < PIPELINE_DEPTH_MAX; i++)
+        {
+            if (pending_commit_used[i] &&
+                pending_commits[i].index == incoming.index)
+            {
+                slot = -2;
+                break;
+            }
+
+            if (!pending_commit_used[i] && slot == -1)
+                slot = i;
+        }
+
+        if (slot >= 0 && incoming.index - height <= PIPELINE_DEPTH_MAX)
+        {
+            printf("[CONSENSUS] Commit for block %d buffered until block %d arrives.\n",
+                   incoming.index, height);
+            pending_commits[slot] = incoming;
+            pending_qcs[slot] = qc;
+            pending_commit_used[slot] = 1;
+        }
+        else
+        {
+            free_block(&incoming);
+        }
+    }
 
-    add_block(&incoming);
+    pthread_mutex_unlock(&commit_lock);
 }
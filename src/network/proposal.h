@@ -1,10 +1,36 @@
 #ifndef PROPOSAL_H
 #define PROPOSAL_H
 
+#include <stddef.h>
+
 #include "../blockchain/block.h"
+#include "../crypto/signature.h"
+
+// proposals a leader may have collecting votes at once
+#define PIPELINE_DEPTH_DEFAULT 4
+#define PIPELINE_DEPTH_MAX 16
+
+// a proposal without a majority by then is dropped with its descendants
+#define PROPOSAL_TIMEOUT_SEC 5
 
-void propose_block(Block *block);
+// validator identity used to sign votes
+void set_validator_identity(Signer *signer, int port);
+int get_validator_port();
+int sign_vote(int index, const Digest *block_hash, char signature[HASH_SIZE]);
+
+// leader side
+int propose_block(Block *block);
 void register_vote(const char *vote);
-void handle_commit(const char *serialized_block);
+void expire_proposals();
+int proposals_in_flight();
+int proposal_pending(int index, const Digest *hash);
+int proposal_tip(int *index, Digest *hash);
+void set_pipeline_depth(int depth);
+int get_pipeline_depth();
+
+// validator side
+int proposal_parent_known(const Block *block);
+void note_approved_proposal(const Block *block);
+void handle_commit(const char *payload, size_t len);
 
 #endif
@@ -1,8 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <sys/socket.h>
+#include <pthread.h>
 
 #include "node.h"
 #include "protocol.h"
@@ -12,215 +11,400 @@
 #include "sync.h"
 #include "../blockchain/blockchain.h"
 
-// sync state tracking
+// sync state tracking; heights and synced blocks arrive on different lanes
 
 static int sync_socket = -1;
 static int sync_target_height = 0;
 static int syncing = 0;
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
 
-// dispatch incoming messages
+static MessageStats stats[MSG_TYPE_COUNT];
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
 
-void protocol_dispatch(int client_socket, const char *message)
+// a vote payload names the proposal it answers as <decision>|index|hash; approvals
+// add |port|signature so the leader can build a quorum certificate
+static void send_vote(int client_socket, const char *decision, const Block *block)
 {
-    char clean_message[BUFFER_SIZE];
-    memset(clean_message, 0, sizeof(clean_message));
+    char hash_hex[DIGEST_HEX_SIZE];
+    char signature[HASH_SIZE];
+    char vote[HASH_SIZE + 160];
 
-    strncpy(clean_message, message, BUFFER_SIZE - 1);
+    digest_to_hex(&block->block_hash, hash_hex);
 
-    // sanitize message
-    size_t len = strlen(clean_message);
-    while (len > 0 &&
-          (clean_message[len - 1] == '\n' ||
-           clean_message[len - 1] == '\r'))
+    if (strcmp(decision, "APPROVE") == 0)
     {
-        clean_message[len - 1] = '\0';
-        len--;
+        if (!sign_vote(block->index, &block->block_hash, signature))
+        {
+            printf("[CRYPTO] Vote signing failed.\n");
+            return;
+        }
+
+        snprintf(vote, sizeof(vote), "%s|%d|%s|%d|%s",
+                 decision, block->index, hash_hex, get_validator_port(), signature);
     }
+    else
+    {
+        snprintf(vote, sizeof(vote), "%s|%d|%s",
+                 decision, block->index, hash_hex);
+    }
+
+    send_text(client_socket, MSG_BLOCK_VOTE, vote);
+}
+
+// message handlers; text payloads arrive NUL-terminated
+
+static void handle_vote_message(int client_socket, const char *payload, size_t len)
+{
+    (void)client_socket;
+    (void)len;
+
+    // approvals carry a signature and are logged once verified
+    if (strncmp(payload, "APPROVE|", 8) != 0)
+        printf("[CONSENSUS] Vote received: %s\n", payload);
+
+    register_vote(payload);
+}
+
+static void handle_commit_message(int client_socket, const char *payload, size_t len)
+{
+    (void)client_socket;
+
+    printf("[CONSENSUS] Commit instruction received.\n");
+    handle_commit(payload, len);
+}
 
-    // handle vote message
-    if (strncmp(clean_message, "BLOCK_VOTE:", 11) == 0)
+static void handle_chain_height(int client_socket, const char *payload, size_t len)
+{
+    (void)len;
+
+    int peer_height = atoi(payload);
+    int local_height = get_blockchain_height();
+    int start = 0;
+
+    pthread_mutex_lock(&sync_lock);
+
+    if (peer_height > local_height && !syncing)
     {
-        printf("[CONSENSUS] Vote received: %s\n", clean_message + 11);
-        register_vote(clean_message);
-        return;
+        printf("[SYNC] Peer chain height %d > local %d. Initiating sync.\n",
+               peer_height, local_height);
+
+        syncing = 1;
+        sync_socket = client_socket;
+        sync_target_height = peer_height;
+        start = 1;
     }
 
-    // handle commit message
-    if (strncmp(clean_message, "COMMIT_BLOCK:", 13) == 0)
+    pthread_mutex_unlock(&sync_lock);
+
+    if (start)
     {
-        printf("[CONSENSUS] Commit instruction received.\n");
-        handle_commit(clean_message + 13);
-        return;
+        char request[32];
+        snprintf(request, sizeof(request), "%d", local_height);
+
+        send_text(client_socket, MSG_GET_BLOCK, request);
     }
+}
+
+static void handle_sync_block(int client_socket, const char *payload, size_t len)
+{
+    Block incoming;
+    memset(&incoming, 0, sizeof(Block));
+
+    pthread_mutex_lock(&sync_lock);
 
-    // handle height response
-    if (strncmp(clean_message, "CHAIN_HEIGHT:", 13) == 0)
+    if (!syncing || client_socket != sync_socket ||
+        !deserialize_block(payload, len, &incoming))
     {
-        int peer_height = atoi(clean_message + 13);
-        int local_height = get_blockchain_height();
+        pthread_mutex_unlock(&sync_lock);
+        return;
+    }
 
-        if (peer_height > local_height && !syncing)
-        {
-            printf("[SYNC] Peer chain height %d > local %d. Initiating sync.\n",
-                   peer_height, local_height);
+    int local_height = get_blockchain_height();
+    Digest last_hash;
 
-            syncing = 1;
-            sync_socket = client_socket;
-            sync_target_height = peer_height;
+    if (incoming.index != local_height)
+    {
+        printf("[SYNC] Out-of-order block %d ignored.\n", incoming.index);
+        pthread_mutex_unlock(&sync_lock);
+        free_block(&incoming);
+        return;
+    }
 
-            char request[64];
-            snprintf(request, sizeof(request),
-                     "GET_BLOCK:%d\n", local_height);
+    if (!get_last_block_hash(&last_hash))
+    {
+        pthread_mutex_unlock(&sync_lock);
+        free_block(&incoming);
+        return;
+    }
 
-            send(sync_socket, request, strlen(request), 0);
-        }
+    if (!digest_equal(&incoming.previous_hash, &last_hash))
+    {
+        printf("[SYNC] Previous hash mismatch during sync.\n");
+        syncing = 0;
+        pthread_mutex_unlock(&sync_lock);
+        free_block(&incoming);
+        return;
+    }
 
+    // nothing from the peer is appended before it checks out
+    if (!block_authentic(&incoming))
+    {
+        printf("[SYNC] Block %d failed hash, merkle root or signature check. Sync stopped.\n",
+               incoming.index);
+        syncing = 0;
+        pthread_mutex_unlock(&sync_lock);
+        free_block(&incoming);
         return;
     }
 
-    // handle block sync
-    if (strncmp(clean_message, "SYNC_BLOCK:", 11) == 0)
+    printf("[SYNC] Appending block %d\n", incoming.index);
+
+    if (!add_block(&incoming))
     {
-        if (!syncing || client_socket != sync_socket)
-            return;
+        printf("[SYNC] Block %d could not be stored. Sync stopped.\n", incoming.index);
+        syncing = 0;
+        pthread_mutex_unlock(&sync_lock);
+        free_block(&incoming);
+        return;
+    }
 
-        const char *serialized = clean_message + 11;
+    free_block(&incoming);
 
-        Block incoming;
-        memset(&incoming, 0, sizeof(Block));
+    local_height++;
 
-        if (!deserialize_block(serialized, &incoming))
-            return;
+    int done = local_height >= sync_target_height;
 
-        int local_height = get_blockchain_height();
+    if (done)
+    {
+        printf("[SYNC] Synchronization complete.\n");
+        syncing = 0;
+    }
 
-        if (incoming.index != local_height)
-        {
-            printf("[SYNC] Out-of-order block %d ignored.\n", incoming.index);
-            return;
-        }
+    pthread_mutex_unlock(&sync_lock);
 
-        Block last_block;
-        if (!get_last_block(&last_block))
-            return;
+    if (!done)
+    {
+        char request[32];
+        snprintf(request, sizeof(request), "%d", local_height);
 
-        if (strcmp(incoming.previous_hash,
-                   last_block.block_hash) != 0)
-        {
-            printf("[SYNC] Previous hash mismatch during sync.\n");
-            syncing = 0;
-            return;
-        }
+        send_text(client_socket, MSG_GET_BLOCK, request);
+    }
+}
 
-        printf("[SYNC] Appending block %d\n", incoming.index);
+static void handle_get_height(int client_socket, const char *payload, size_t len)
+{
+    (void)payload;
+    (void)len;
 
-        add_block(&incoming);
+    int height = get_blockchain_height();
 
-        local_height++;
+    char response[32];
+    snprintf(response, sizeof(response), "%d", height);
 
-        if (local_height < sync_target_height)
-        {
-            char request[64];
-            snprintf(request, sizeof(request),
-                     "GET_BLOCK:%d\n", local_height);
+    send_text(client_socket, MSG_CHAIN_HEIGHT, response);
+}
 
-            send(sync_socket, request, strlen(request), 0);
-        }
-        else
-        {
-            printf("[SYNC] Synchronization complete.\n");
-            syncing = 0;
-        }
+static void handle_get_block(int client_socket, const char *payload, size_t len)
+{
+    (void)len;
 
+    int index = atoi(payload);
+
+    Block block;
+
+    if (!get_block_by_index(index, &block))
         return;
-    }
 
-    // handle data requests
+    size_t frame_len = 0;
+    char *data = serialize_block_frame(MSG_SYNC_BLOCK, &block, &frame_len);
+    SharedBuffer *frame = shared_buffer_wrap(data, frame_len);
 
-    if (strcmp(clean_message, "GET_HEIGHT") == 0)
+    if (frame)
     {
-        int height = get_blockchain_height();
+        send_buffer(client_socket, frame);
+        shared_buffer_release(frame);
+    }
 
-        char response[64];
-        snprintf(response, sizeof(response),
-                 "CHAIN_HEIGHT:%d\n", height);
+    free_block(&block);
+}
 
-        send(client_socket, response, strlen(response), 0);
+// inclusion proof of one record against its block header
+static void handle_get_proof(int client_socket, const char *payload, size_t len)
+{
+    (void)len;
+
+    Digest data_hash;
+    Block block;
+    int tx_index;
+    MerkleProof proof;
+
+    if (!digest_from_hex(payload, data_hash.bytes) ||
+        !find_transaction(&data_hash, &block, &tx_index))
+    {
+        send_text(client_socket, MSG_PROOF, "NONE");
         return;
     }
 
-    if (strncmp(clean_message, "GET_BLOCK:", 10) == 0)
+    if (block.version < BLOCK_VERSION_MERKLE ||
+        !block_merkle_proof(&block, tx_index, &proof))
     {
-        int index = atoi(clean_message + 10);
+        free_block(&block);
+        send_text(client_socket, MSG_PROOF, "NONE");
+        return;
+    }
 
-        Block block;
+    char buffer[SERIALIZED_PROOF_SIZE];
+    serialize_proof(&block, tx_index, &proof, buffer);
+    free_block(&block);
 
-        if (get_block_by_index(index, &block))
-        {
-            char buffer[SERIALIZED_BLOCK_SIZE];
-            serialize_block(&block, buffer);
+    send_text(client_socket, MSG_PROOF, buffer);
+}
 
-            char msg[SERIALIZED_BLOCK_SIZE + 32];
-            snprintf(msg, sizeof(msg),
-                     "SYNC_BLOCK:%s\n", buffer);
+static void handle_proposal(int client_socket, const char *payload, size_t len)
+{
+    Block incoming;
+    memset(&incoming, 0, sizeof(Block));
 
-            send(client_socket, msg, strlen(msg), 0);
-        }
+    if (!deserialize_block(payload, len, &incoming))
+    {
+        printf("[CONSENSUS] Block rejected: Deserialize failed.\n");
+        send_text(client_socket, MSG_BLOCK_VOTE, "REJECT");
+        return;
+    }
 
+    int height = get_blockchain_height();
+
+    // pipelined proposals may run ahead of the local tip
+    if (incoming.index < height ||
+        incoming.index > height + PIPELINE_DEPTH_MAX)
+    {
+        printf("[CONSENSUS] Block %d rejected: Index mismatch.\n",
+               incoming.index);
+        send_vote(client_socket, "REJECT", &incoming);
+        free_block(&incoming);
         return;
     }
 
-    // handle block proposal
-    if (strncmp(clean_message, "PROPOSE_BLOCK:", 14) == 0)
+    if (!proposal_parent_known(&incoming))
     {
-        Block incoming;
-        memset(&incoming, 0, sizeof(Block));
+        printf("[CONSENSUS] Block %d rejected: Previous hash mismatch.\n",
+               incoming.index);
+        send_vote(client_socket, "REJECT", &incoming);
+        free_block(&incoming);
+        return;
+    }
 
-        if (!deserialize_block(clean_message + 14, &incoming))
-        {
-            printf("[CONSENSUS] Block rejected: Deserialize failed.\n");
-            send(client_socket, "BLOCK_VOTE:REJECT\n", 18, 0);
-            return;
-        }
+    if (!block_authentic(&incoming))
+    {
+        printf("[CONSENSUS] Block %d rejected: Hash, merkle root or signature invalid.\n",
+               incoming.index);
+        send_vote(client_socket, "REJECT", &incoming);
+        free_block(&incoming);
+        return;
+    }
 
-        Block last_block;
+    if (!verify_blockchain())
+    {
+        printf("[CONSENSUS] Block %d rejected: Local chain invalid.\n",
+               incoming.index);
+        send_vote(client_socket, "REJECT", &incoming);
+        free_block(&incoming);
+        return;
+    }
 
-        if (!get_last_block(&last_block))
-        {
-            printf("[CONSENSUS] Block rejected: No last block.\n");
-            send(client_socket, "BLOCK_VOTE:REJECT\n", 18, 0);
-            return;
-        }
+    note_approved_proposal(&incoming);
 
-        if (incoming.index != last_block.index + 1)
-        {
-            printf("[CONSENSUS] Block %d rejected: Index mismatch.\n",
-                   incoming.index);
-            send(client_socket, "BLOCK_VOTE:REJECT\n", 18, 0);
-            return;
-        }
+    printf("[CONSENSUS] Block %d approved.\n", incoming.index);
+    send_vote(client_socket, "APPROVE", &incoming);
+    free_block(&incoming);
+}
 
-        if (strcmp(incoming.previous_hash,
-                   last_block.block_hash) != 0)
-        {
-            printf("[CONSENSUS] Block %d rejected: Previous hash mismatch.\n",
-                   incoming.index);
-            send(client_socket, "BLOCK_VOTE:REJECT\n", 18, 0);
-            return;
-        }
+typedef void (*MessageHandler)(int client_socket, const char *payload, size_t len);
+
+typedef struct {
+    int lane;
+    MessageHandler handle;
+} HandlerEntry;
+
+// handler registry indexed by message type; hello is consumed by the
+// connection itself
+static const HandlerEntry handlers[MSG_TYPE_COUNT] = {
+    { LANE_CONTROL, NULL },                    // unused
+    { LANE_CONTROL, NULL },                    // MSG_HELLO
+    { LANE_CONTROL, handle_get_height },       // MSG_GET_HEIGHT
+    { LANE_CONTROL, handle_chain_height },     // MSG_CHAIN_HEIGHT
+    { LANE_SERVING, handle_get_block },        // MSG_GET_BLOCK
+    { LANE_BLOCKS, handle_sync_block },        // MSG_SYNC_BLOCK
+    { LANE_BLOCKS, handle_proposal },          // MSG_PROPOSE_BLOCK
+    { LANE_CONTROL, handle_vote_message },     // MSG_BLOCK_VOTE
+    { LANE_BLOCKS, handle_commit_message },    // MSG_COMMIT_BLOCK
+    { LANE_SERVING, handle_get_proof },        // MSG_GET_PROOF
+    { LANE_CONTROL, NULL }                     // MSG_PROOF, only clients ask
+};
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000.0 +
+           (to->tv_nsec - from->tv_nsec) / 1e6;
+}
 
-        if (!verify_blockchain())
-        {
-            printf("[CONSENSUS] Block %d rejected: Local chain invalid.\n",
-                   incoming.index);
-            send(client_socket, "BLOCK_VOTE:REJECT\n", 18, 0);
-            return;
-        }
+// worker lane serving a message type
+int protocol_lane(int type)
+{
+    return type > 0 && type < MSG_TYPE_COUNT ? handlers[type].lane : LANE_CONTROL;
+}
 
-        printf("[CONSENSUS] Block %d approved.\n", incoming.index);
-        send(client_socket, "BLOCK_VOTE:APPROVE\n", 19, 0);
+void protocol_note_queued(int type)
+{
+    if (type <= 0 || type >= MSG_TYPE_COUNT)
+        return;
+
+    pthread_mutex_lock(&stats_lock);
+    stats[type].queued++;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+// run the registered handler and account for the time spent
+void protocol_dispatch(int client_socket, int type, const char *payload, size_t len,
+                       const struct timespec *queued_at)
+{
+    if (type <= 0 || type >= MSG_TYPE_COUNT || !handlers[type].handle)
+        return;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    handlers[type].handle(client_socket, payload, len);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double wait = elapsed_ms(queued_at, &start);
+    double run = elapsed_ms(&start, &end);
+
+    pthread_mutex_lock(&stats_lock);
+
+    MessageStats *entry = &stats[type];
+    entry->handled++;
+    entry->wait_total_ms += wait;
+    entry->run_total_ms += run;
+
+    if (wait > entry->wait_max_ms)
+        entry->wait_max_ms = wait;
+
+    if (run > entry->run_max_ms)
+        entry->run_max_ms = run;
+
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void protocol_get_stats(int type, MessageStats *out)
+{
+    memset(out, 0, sizeof(MessageStats));
+
+    if (type <= 0 || type >= MSG_TYPE_COUNT)
         return;
-    }
 
-    /* Ignore unknown messages silently */
+    pthread_mutex_lock(&stats_lock);
+    *out = stats[type];
+    pthread_mutex_unlock(&stats_lock);
 }
@@ -1,9 +1,31 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
-#define CMD_PROPOSE_BLOCK "PROPOSE_BLOCK:"
-#define CMD_BLOCK_VOTE    "BLOCK_VOTE:"
 
+#include <stddef.h>
+#include <time.h>
 
-void protocol_dispatch(int client_socket, const char *message);
+#include "wire.h"
+
+// worker lanes in priority order; every message type is served by one
+#define LANE_CONTROL 0    // votes and heights
+#define LANE_BLOCKS 1     // proposals, commits and synced blocks
+#define LANE_SERVING 2    // blocks and proofs requested by peers
+#define LANE_COUNT 3
+
+// counters kept per message type
+typedef struct {
+    unsigned long queued;
+    unsigned long handled;
+    double wait_total_ms;     // from arrival until a worker picked it up
+    double wait_max_ms;
+    double run_total_ms;      // inside the handler
+    double run_max_ms;
+} MessageStats;
+
+int protocol_lane(int type);
+void protocol_note_queued(int type);
+void protocol_dispatch(int client_socket, int type, const char *payload, size_t len,
+                       const struct timespec *queued_at);
+void protocol_get_stats(int type, MessageStats *out);
 
 #endif
@@ -1,105 +1,289 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 #include "serializer.h"
+#include "../blockchain/storage.h"
 
-// serialize block to string
-void serialize_block(Block *block, char *buffer)
+// append formatted text at *used; an overflow pins *used to size
+static void append_text(char *buffer, size_t size, size_t *used, const char *format, ...)
 {
-    buffer[0] = '\0';
-    char line[4096];
-
-    // header format: index|time|prev|hash|port|sig|count
-    snprintf(line, sizeof(line),
-             "%d|%ld|%s|%s|%d|%s|%d~",
-             block->index,
-             block->timestamp,
-             block->previous_hash,
-             block->block_hash,
-             block->validator_port,          // included
-             block->validator_signature,
-             block->transaction_count);
-
-    strncat(buffer, line, SERIALIZED_BLOCK_SIZE - strlen(buffer) - 1);
-
-    // serialize transactions
-    for (int i = 0; i < block->transaction_count; i++)
+    if (*used >= size)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + *used, size - *used, format, args);
+    va_end(args);
+
+    if (n < 0 || (size_t)n >= size - *used)
+        *used = size;
+    else
+        *used += (size_t)n;
+}
+
+// header line: index|time|prev|hash|port|sig|count|version|merkle~
+static void serialize_header(const Block *block, char *buffer, size_t size, size_t *used)
+{
+    char previous_hex[DIGEST_HEX_SIZE];
+    char block_hex[DIGEST_HEX_SIZE];
+    char merkle_hex[DIGEST_HEX_SIZE];
+
+    // digests travel as hex on the wire
+    digest_to_hex(&block->previous_hash, previous_hex);
+    digest_to_hex(&block->block_hash, block_hex);
+    digest_to_hex(&block->merkle_root, merkle_hex);
+
+    append_text(buffer, size, used,
+                "%d|%ld|%s|%s|%d|%s|%d|%d|%s~",
+                block->index,
+                block->timestamp,
+                previous_hex,
+                block_hex,
+                block->validator_port,          // included
+                block->validator_signature,
+                block->transaction_count,
+                block->version,
+                merkle_hex);
+}
+
+static void serialize_transaction(const Transaction *tx, char *buffer, size_t size, size_t *used)
+{
+    char data_hex[DIGEST_HEX_SIZE];
+    digest_to_hex(&tx->data_hash, data_hex);
+
+    append_text(buffer, size, used,
+                "TX|%s|%s|%s|%s|%ld~",
+                tx->patient_id,
+                tx->doctor_id,
+                data_hex,
+                tx->data_pointer,
+                tx->timestamp);
+}
+
+// frame a block as its binary record in a heap buffer the caller frees
+char *serialize_block_frame(int type, const Block *block, size_t *frame_len)
+{
+    size_t size = WIRE_HEADER_SIZE + block_record_bound(block);
+    char *frame = malloc(size);
+
+    if (!frame)
+        return NULL;
+
+    size_t len = encode_block_record(block, (unsigned char *)frame + WIRE_HEADER_SIZE,
+                                     size - WIRE_HEADER_SIZE);
+    if (len == 0)
     {
-        snprintf(line, sizeof(line),
-                 "TX|%s|%s|%s|%s|%ld~",
-                 block->transactions[i].patient_id,
-                 block->transactions[i].doctor_id,
-                 block->transactions[i].data_hash,
-                 block->transactions[i].data_pointer,
-                 block->transactions[i].timestamp);
-
-        strncat(buffer, line, SERIALIZED_BLOCK_SIZE - strlen(buffer) - 1);
+        free(frame);
+        return NULL;
     }
 
-    strncat(buffer, "END_BLOCK~", SERIALIZED_BLOCK_SIZE - strlen(buffer) - 1);
+    wire_put_header((unsigned char *)frame, type, len);
+    *frame_len = WIRE_HEADER_SIZE + len;
+
+    return frame;
 }
 
-// parse block from string
-int deserialize_block(const char *buffer, Block *block)
+// the payload must be exactly one block record; the block owns its
+// transactions on success
+int deserialize_block(const char *payload, size_t len, Block *block)
 {
-    memset(block, 0, sizeof(Block));
+    size_t record_len = 0;
 
-    char copy[SERIALIZED_BLOCK_SIZE];
-    strncpy(copy, buffer, sizeof(copy) - 1);
-    copy[sizeof(copy) - 1] = '\0';
+    if (!decode_block_record((const unsigned char *)payload, len, block, &record_len))
+        return 0;
 
-    char *line = strtok(copy, "~");
+    if (record_len != len)
+    {
+        free_block(block);
+        return 0;
+    }
 
-    // parse header fields
-    if (!line)
+    return 1;
+}
+
+// commit payload: quorum record followed by the block record
+char *serialize_commit_frame(const Block *block, const QuorumCertificate *qc,
+                             size_t *frame_len)
+{
+    size_t size = WIRE_HEADER_SIZE + QUORUM_RECORD_MAX + block_record_bound(block);
+    char *frame = malloc(size);
+
+    if (!frame)
+        return NULL;
+
+    unsigned char *out = (unsigned char *)frame + WIRE_HEADER_SIZE;
+    size_t qc_len = encode_quorum_record(qc, out, QUORUM_RECORD_MAX);
+    size_t block_len = qc_len ? encode_block_record(block, out + qc_len,
+                                                    size - WIRE_HEADER_SIZE - qc_len) : 0;
+    if (block_len == 0)
+    {
+        free(frame);
+        return NULL;
+    }
+
+    wire_put_header((unsigned char *)frame, MSG_COMMIT_BLOCK, qc_len + block_len);
+    *frame_len = WIRE_HEADER_SIZE + qc_len + block_len;
+
+    return frame;
+}
+
+int deserialize_commit(const char *payload, size_t len,
+                       QuorumCertificate *qc, Block *block)
+{
+    size_t qc_len = 0;
+
+    if (!decode_quorum_record((const unsigned char *)payload, len, qc, &qc_len))
         return 0;
 
-    // expected: index|timestamp|previous_hash|block_hash|validator_port|signature|tx_count
-    if (sscanf(line,
-               "%d|%ld|%64[^|]|%64[^|]|%d|%512[^|]|%d",
-               &block->index,
-               &block->timestamp,
-               block->previous_hash,
-               block->block_hash,
-               &block->validator_port,        // parsed
-               block->validator_signature,
-               &block->transaction_count) != 7)
+    return deserialize_block(payload + qc_len, len - qc_len, block);
+}
+
+// parse a header line; legacy peers stop after the count, v2 after the version
+static int parse_header(const char *line, Block *block)
+{
+    char previous_hex[DIGEST_HEX_SIZE];
+    char block_hex[DIGEST_HEX_SIZE];
+    char merkle_hex[DIGEST_HEX_SIZE] = "0";
+
+    // expected: index|timestamp|previous_hash|block_hash|validator_port|signature|tx_count|version|merkle_root
+    int fields = sscanf(line,
+                        "%d|%ld|%64[^|]|%64[^|]|%d|%512[^|]|%d|%d|%64[^|]",
+                        &block->index,
+                        &block->timestamp,
+                        previous_hex,
+                        block_hex,
+                        &block->validator_port,        // parsed
+                        block->validator_signature,
+                        &block->transaction_count,
+                        &block->version,
+                        merkle_hex);
+
+    // peers that predate block versions only send legacy blocks
+    if (fields == 7)
+        block->version = BLOCK_VERSION_LEGACY;
+    else if (fields < 8)
+        return 0;
+
+    if (!block_version_supported(block->version) ||
+        (block->version >= BLOCK_VERSION_MERKLE && fields != 9))
+        return 0;
+
+    if (!digest_parse(previous_hex, &block->previous_hash) ||
+        !digest_parse(block_hex, &block->block_hash) ||
+        !digest_parse(merkle_hex, &block->merkle_root))
         return 0;
 
     if (block->transaction_count < 0 ||
         block->transaction_count > MAX_TRANSACTIONS)
         return 0;
 
-    // parse transaction fields
-    int tx_index = 0;
+    return 1;
+}
+
+static int parse_transaction(const char *line, Transaction *tx)
+{
+    char data_hex[DIGEST_HEX_SIZE];
+
+    if (sscanf(line,
+               "TX|%31[^|]|%31[^|]|%64[^|]|%127[^|]|%ld",
+               tx->patient_id,
+               tx->doctor_id,
+               data_hex,
+               tx->data_pointer,
+               &tx->timestamp) != 5)
+        return 0;
+
+    return digest_parse(data_hex, &tx->data_hash);
+}
+
+// proof format: header~TX|...~PATH|leaf_index|leaf_count|sibling,sibling,...~END_PROOF~
+// the header keeps its transaction count but carries no transactions
+void serialize_proof(const Block *block, int tx_index,
+                     const MerkleProof *proof, char *buffer)
+{
+    size_t used = 0;
+
+    serialize_header(block, buffer, SERIALIZED_PROOF_SIZE, &used);
+    serialize_transaction(&block->transactions[tx_index], buffer, SERIALIZED_PROOF_SIZE, &used);
 
-    while ((line = strtok(NULL, "~")) != NULL)
+    append_text(buffer, SERIALIZED_PROOF_SIZE, &used, "PATH|%d|%d|",
+                proof->leaf_index, proof->leaf_count);
+
+    for (int i = 0; i < proof->depth; i++)
     {
-        if (strcmp(line, "END_BLOCK") == 0)
-            break;
-
-        if (strncmp(line, "TX|", 3) == 0)
-        {
-            if (tx_index >= MAX_TRANSACTIONS)
-                return 0;
-
-            if (sscanf(line,
-                       "TX|%31[^|]|%31[^|]|%64[^|]|%127[^|]|%ld",
-                       block->transactions[tx_index].patient_id,
-                       block->transactions[tx_index].doctor_id,
-                       block->transactions[tx_index].data_hash,
-                       block->transactions[tx_index].data_pointer,
-                       &block->transactions[tx_index].timestamp) != 5)
-                return 0;
-
-            tx_index++;
-        }
+        char sibling_hex[DIGEST_HEX_SIZE];
+        digest_to_hex(&proof->siblings[i], sibling_hex);
+
+        append_text(buffer, SERIALIZED_PROOF_SIZE, &used, i > 0 ? ",%s" : "%s", sibling_hex);
     }
 
-    // verify transaction count
-    if (tx_index != block->transaction_count)
-        return 0;
+    append_text(buffer, SERIALIZED_PROOF_SIZE, &used, "~END_PROOF~");
+}
+
+// parse "a,b,c" into proof siblings
+static int parse_siblings(const char *list, MerkleProof *proof)
+{
+    proof->depth = 0;
+
+    while (*list)
+    {
+        const char *end = strchr(list, ',');
+        size_t len = end ? (size_t)(end - list) : strlen(list);
+        char hex[DIGEST_HEX_SIZE];
+
+        if (len == 0 || len >= sizeof(hex) || proof->depth >= MERKLE_MAX_DEPTH)
+            return 0;
+
+        memcpy(hex, list, len);
+        hex[len] = '\0';
+
+        if (!digest_parse(hex, &proof->siblings[proof->depth++]))
+            return 0;
+
+        list += len;
+        if (*list == ',')
+            list++;
+    }
 
     return 1;
 }
+
+// the parsed header keeps its transaction count but has no transaction list
+int deserialize_proof(const char *buffer, Block *header,
+                      Transaction *tx, MerkleProof *proof)
+{
+    memset(header, 0, sizeof(Block));
+    memset(tx, 0, sizeof(Transaction));
+    memset(proof, 0, sizeof(MerkleProof));
+
+    char copy[SERIALIZED_PROOF_SIZE];
+    strncpy(copy, buffer, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    char *save = NULL;
+    char *line = strtok_r(copy, "~", &save);
+    if (!line || !parse_header(line, header))
+        return 0;
+
+    line = strtok_r(NULL, "~", &save);
+    if (!line || strncmp(line, "TX|", 3) != 0 || !parse_transaction(line, tx))
+        return 0;
+
+    line = strtok_r(NULL, "~", &save);
+    if (!line || strncmp(line, "PATH|", 5) != 0)
+        return 0;
+
+    int consumed = 0;
+    if (sscanf(line, "PATH|%d|%d|%n",
+               &proof->leaf_index, &proof->leaf_count, &consumed) != 2 ||
+        consumed == 0)
+        return 0;
+
+    if (!parse_siblings(line + consumed, proof))
+        return 0;
+
+    line = strtok_r(NULL, "~", &save);
+    return line && strcmp(line, "END_PROOF") == 0;
+}
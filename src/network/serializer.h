@@ -1,11 +1,27 @@
 #ifndef SERIALIZER_H
 #define SERIALIZER_H
 
+#include <stddef.h>
+
 #include "../blockchain/block.h"
+#include "../blockchain/quorum.h"
+#include "wire.h"
+
+// blocks travel as the binary record the chain file stores; proofs stay
+// text for simple clients
+#define SERIALIZED_PROOF_SIZE 4096
+
+char *serialize_block_frame(int type, const Block *block, size_t *frame_len);
+int deserialize_block(const char *payload, size_t len, Block *block);
 
-#define SERIALIZED_BLOCK_SIZE 8192
+char *serialize_commit_frame(const Block *block, const QuorumCertificate *qc,
+                             size_t *frame_len);
+int deserialize_commit(const char *payload, size_t len,
+                       QuorumCertificate *qc, Block *block);
 
-void serialize_block(Block *block, char *buffer);
-int deserialize_block(const char *buffer, Block *block);
+void serialize_proof(const Block *block, int tx_index,
+                     const MerkleProof *proof, char *buffer);
+int deserialize_proof(const char *buffer, Block *header,
+                      Transaction *tx, MerkleProof *proof);
 
 #endif
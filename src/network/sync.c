@@ -1,8 +1,8 @@
 #include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
 
 #include "node.h"
+#include "wire.h"
 #include "../blockchain/blockchain.h"
 
 // start chain sync
@@ -11,7 +11,7 @@ void initiate_chain_sync()
     printf("[SYNC] Initiating chain synchronization...\n");
 
     // query peers for height
-    broadcast_message("GET_HEIGHT\n");
+    broadcast_text(MSG_GET_HEIGHT, "");
 }
 
 // request full chain download
@@ -23,11 +23,10 @@ void force_full_resync(int client_socket)
 
     for (int i = 0; i < local_height; i++)
     {
-        char request[64];
-        snprintf(request, sizeof(request),
-                 "GET_BLOCK:%d\n", i);
+        char request[32];
+        snprintf(request, sizeof(request), "%d", i);
 
-        send(client_socket, request, strlen(request), 0);
+        send_text(client_socket, MSG_GET_BLOCK, request);
     }
 }
 
@@ -35,5 +34,5 @@ void force_full_resync(int client_socket)
 void handle_sync_mismatch(int client_socket)
 {
     printf("[SYNC] Chain mismatch detected. Requesting updated height.\n");
-    send(client_socket, "GET_HEIGHT\n", 11, 0);
+    send_text(client_socket, MSG_GET_HEIGHT, "");
 }
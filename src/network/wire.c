@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "wire.h"
+
+static const char *type_names[MSG_TYPE_COUNT] = {
+    "UNKNOWN", "HELLO", "GET_HEIGHT", "CHAIN_HEIGHT", "GET_BLOCK",
+    "SYNC_BLOCK", "PROPOSE_BLOCK", "BLOCK_VOTE", "COMMIT_BLOCK",
+    "GET_PROOF", "PROOF"
+};
+
+void wire_put_header(unsigned char *out, int type, size_t payload_len)
+{
+    out[0] = WIRE_MAGIC_0;
+    out[1] = WIRE_MAGIC_1;
+    out[2] = WIRE_VERSION;
+    out[3] = (unsigned char)type;
+    out[4] = (unsigned char)(payload_len & 0xff);
+    out[5] = (unsigned char)((payload_len >> 8) & 0xff);
+    out[6] = (unsigned char)((payload_len >> 16) & 0xff);
+    out[7] = (unsigned char)((payload_len >> 24) & 0xff);
+}
+
+// 0 for a header that is not ours or carries an unknown version or type
+int wire_parse_header(const unsigned char *in, int *version, int *type, size_t *payload_len)
+{
+    if (in[0] != WIRE_MAGIC_0 || in[1] != WIRE_MAGIC_1)
+        return 0;
+
+    *version = in[2];
+    *type = in[3];
+    *payload_len = (size_t)in[4] | ((size_t)in[5] << 8) |
+                   ((size_t)in[6] << 16) | ((size_t)in[7] << 24);
+
+    return *version >= WIRE_MIN_VERSION && *version <= WIRE_VERSION &&
+           *type > 0 && *type < MSG_TYPE_COUNT;
+}
+
+// hello and block payloads are binary, checked by their decoders; every
+// other payload is text that carries its terminating NUL, so handlers can
+// parse it where it was received
+int wire_payload_valid(int type, const char *payload, size_t len)
+{
+    if (type == MSG_HELLO)
+        return len == WIRE_HELLO_SIZE;
+
+    if (type == MSG_SYNC_BLOCK || type == MSG_PROPOSE_BLOCK || type == MSG_COMMIT_BLOCK)
+        return len > 0;
+
+    return len > 0 && payload[len - 1] == '\0';
+}
+
+const char *wire_type_name(int type)
+{
+    return type > 0 && type < MSG_TYPE_COUNT ? type_names[type] : type_names[0];
+}
+
+// header plus payload in one heap buffer
+char *wire_frame(int type, const void *payload, size_t len, size_t *frame_len)
+{
+    char *frame = malloc(WIRE_HEADER_SIZE + len);
+
+    if (!frame)
+        return NULL;
+
+    wire_put_header((unsigned char *)frame, type, len);
+    memcpy(frame + WIRE_HEADER_SIZE, payload, len);
+
+    *frame_len = WIRE_HEADER_SIZE + len;
+    return frame;
+}
+
+char *wire_text_frame(int type, const char *text, size_t *frame_len)
+{
+    return wire_frame(type, text, strlen(text) + 1, frame_len);
+}
+
+char *wire_hello_frame(int port, size_t *frame_len)
+{
+    unsigned char hello[WIRE_HELLO_SIZE];
+
+    hello[0] = WIRE_MIN_VERSION;
+    hello[1] = WIRE_VERSION;
+    hello[2] = (unsigned char)(port & 0xff);
+    hello[3] = (unsigned char)((port >> 8) & 0xff);
+    hello[4] = (unsigned char)((port >> 16) & 0xff);
+    hello[5] = (unsigned char)((port >> 24) & 0xff);
+
+    return wire_frame(MSG_HELLO, hello, sizeof(hello), frame_len);
+}
+
+// settle on the highest version both sides speak; 0 when there is none
+int wire_parse_hello(const char *payload, size_t len, int *version, int *port)
+{
+    const unsigned char *in = (const unsigned char *)payload;
+
+    if (len != WIRE_HELLO_SIZE)
+        return 0;
+
+    int peer_min = in[0];
+    int peer_max = in[1];
+
+    *port = (int)((uint32_t)in[2] | ((uint32_t)in[3] << 8) |
+                  ((uint32_t)in[4] << 16) | ((uint32_t)in[5] << 24));
+    *version = peer_max < WIRE_VERSION ? peer_max : WIRE_VERSION;
+
+    return *version >= peer_min && *version >= WIRE_MIN_VERSION;
+}
+
+static int send_all(int socket, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(socket, data, len, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return 0;
+
+        data += n;
+        len -= (size_t)n;
+    }
+
+    return 1;
+}
+
+static int recv_all(int socket, char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = recv(socket, data, len, 0);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return 0;
+
+        data += n;
+        len -= (size_t)n;
+    }
+
+    return 1;
+}
+
+int wire_write_frame(int socket, int type, const void *payload, size_t len)
+{
+    size_t frame_len;
+    char *frame = wire_frame(type, payload, len, &frame_len);
+
+    if (!frame)
+        return 0;
+
+    int ok = send_all(socket, frame, frame_len);
+    free(frame);
+
+    return ok;
+}
+
+// read one whole frame; the caller frees the payload
+char *wire_read_frame(int socket, int *type, size_t *len, size_t max_len)
+{
+    unsigned char header[WIRE_HEADER_SIZE];
+    int version;
+
+    if (!recv_all(socket, (char *)header, sizeof(header)) ||
+        !wire_parse_header(header, &version, type, len) ||
+        *len > max_len)
+        return NULL;
+
+    char *payload = malloc(*len + 1);
+
+    if (!payload)
+        return NULL;
+
+    if (!recv_all(socket, payload, *len))
+    {
+        free(payload);
+        return NULL;
+    }
+
+    payload[*len] = '\0';
+    return payload;
+}
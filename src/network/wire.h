@@ -0,0 +1,47 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// frame header: magic(2) version(1) type(1) payload length(4, little endian)
+#define WIRE_HEADER_SIZE 8
+#define WIRE_MAGIC_0 0xB1
+#define WIRE_MAGIC_1 0x0C
+
+// framing versions this build speaks; peers settle on the highest shared one.
+// v2 carries blocks as binary records, so text-block v1 peers are refused
+#define WIRE_MIN_VERSION 2
+#define WIRE_VERSION 2
+
+// message types
+#define MSG_HELLO 1
+#define MSG_GET_HEIGHT 2
+#define MSG_CHAIN_HEIGHT 3
+#define MSG_GET_BLOCK 4
+#define MSG_SYNC_BLOCK 5
+#define MSG_PROPOSE_BLOCK 6
+#define MSG_BLOCK_VOTE 7
+#define MSG_COMMIT_BLOCK 8
+#define MSG_GET_PROOF 9
+#define MSG_PROOF 10
+#define MSG_TYPE_COUNT 11
+
+// hello payload: min version(1) max version(1) validator port(4), port 0 for clients
+#define WIRE_HELLO_SIZE 6
+
+void wire_put_header(unsigned char *out, int type, size_t payload_len);
+int wire_parse_header(const unsigned char *in, int *version, int *type, size_t *payload_len);
+int wire_payload_valid(int type, const char *payload, size_t len);
+const char *wire_type_name(int type);
+
+char *wire_frame(int type, const void *payload, size_t len, size_t *frame_len);
+char *wire_text_frame(int type, const char *text, size_t *frame_len);
+char *wire_hello_frame(int port, size_t *frame_len);
+int wire_parse_hello(const char *payload, size_t len, int *version, int *port);
+
+// blocking helpers for simple clients
+int wire_write_frame(int socket, int type, const void *payload, size_t len);
+char *wire_read_frame(int socket, int *type, size_t *len, size_t max_len);
+
+#endif
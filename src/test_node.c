@@ -6,16 +6,72 @@
 #include <time.h>
 
 #include "network/node.h"
+#include "network/protocol.h"
 #include "network/serializer.h"
 #include "network/proposal.h"
 #include "network/sync.h"
+#include "network/assembler.h"
 
 #include "blockchain/block.h"
 #include "blockchain/blockchain.h"
+#include "blockchain/mempool.h"
 
 #include "crypto/hash.h"
 #include "crypto/signature.h"
 
+// hash one record and queue it for the next block
+static int queue_record_file(const char *record_filename)
+{
+    Transaction tx;
+    memset(&tx, 0, sizeof(Transaction));
+
+    // the path is stored in the transaction, so it must fit there whole
+    char filepath[sizeof(tx.data_pointer)];
+    int path_len = snprintf(filepath, sizeof(filepath),
+                            "offchain/records/%s", record_filename);
+
+    if (path_len < 0 || (size_t)path_len >= sizeof(filepath))
+    {
+        printf("[ERROR] Record name too long: %s\n", record_filename);
+        return 0;
+    }
+
+    if (!sha256_file(filepath, &tx.data_hash))
+    {
+        printf("[ERROR] File not found: %s\n", record_filename);
+        return 0;
+    }
+
+    strcpy(tx.patient_id, "PATIENT_FROM_FILE");
+    strcpy(tx.doctor_id, "DOCTOR_FROM_FILE");
+    memcpy(tx.data_pointer, filepath, path_len + 1);
+    tx.timestamp = time(NULL);
+
+    switch (mempool_add(&tx))
+    {
+    case MEMPOOL_ADDED:
+        printf("[MEMPOOL] Queued %s (%d pending)\n",
+               record_filename, mempool_size());
+        return 1;
+
+    case MEMPOOL_ON_CHAIN:
+        printf("[CONSENSUS] Duplicate record detected: %s\n", record_filename);
+        return 0;
+
+    case MEMPOOL_DUPLICATE:
+        printf("[MEMPOOL] Record already pending: %s\n", record_filename);
+        return 0;
+
+    case MEMPOOL_FULL:
+        printf("[MEMPOOL] Mempool full, %s not queued.\n", record_filename);
+        return 0;
+
+    default:
+        printf("[MEMPOOL] Could not queue %s\n", record_filename);
+        return 0;
+    }
+}
+
 // server thread handler
 void *server_runner(void *arg)
 {
@@ -27,11 +83,16 @@ void *server_runner(void *arg)
 // print block content
 void print_block(Block *block)
 {
+    char hex[DIGEST_HEX_SIZE];
+
     printf("--------------------------------------------------\n");
     printf("[BLOCK] Index: %d\n", block->index);
+    printf("[BLOCK] Version: %d\n", block->version);
     printf("[BLOCK] Timestamp: %ld\n", block->timestamp);
-    printf("[BLOCK] Previous Hash: %s\n", block->previous_hash);
-    printf("[BLOCK] Block Hash: %s\n", block->block_hash);
+    digest_to_hex(&block->previous_hash, hex);
+    printf("[BLOCK] Previous Hash: %s\n", hex);
+    digest_to_hex(&block->block_hash, hex);
+    printf("[BLOCK] Block Hash: %s\n", hex);
     printf("[BLOCK] Validator Port: %d\n", block->validator_port);
     printf("[BLOCK] Transactions: %d\n", block->transaction_count);
 
@@ -40,7 +101,8 @@ void print_block(Block *block)
         printf("  [TX %d]\n", i + 1);
         printf("     Patient ID: %s\n", block->transactions[i].patient_id);
         printf("     Doctor ID: %s\n", block->transactions[i].doctor_id);
-        printf("     Data Hash: %s\n", block->transactions[i].data_hash);
+        digest_to_hex(&block->transactions[i].data_hash, hex);
+        printf("     Data Hash: %s\n", hex);
         printf("     File Path: %s\n", block->transactions[i].data_pointer);
         printf("     Timestamp: %ld\n", block->transactions[i].timestamp);
     }
@@ -77,9 +139,27 @@ int main(int argc, char *argv[])
         genesis.validator_port = own_port;
         create_genesis_block(&genesis, own_port);
         add_block(&genesis);
+        free_block(&genesis);
 
         printf("[BLOCKCHAIN] Genesis created.\n");
     }
+    else
+    {
+        free_block(&last_block);
+    }
+
+    // keep the private key loaded for block production
+    char private_key_path[64];
+    snprintf(private_key_path, sizeof(private_key_path),
+             "keys/%d_private.pem", own_port);
+
+    Signer *signer = signer_open(private_key_path);
+
+    // votes are signed with the same key
+    set_validator_identity(signer, own_port);
+
+    if (!start_block_assembler(signer, own_port))
+        printf("[CONSENSUS] Block assembler unavailable; ADD is disabled.\n");
 
     pthread_t server_thread;
     pthread_create(&server_thread, NULL, server_runner, &own_port);
@@ -101,85 +181,24 @@ int main(int argc, char *argv[])
     // interactive command loop
     while (1)
     {
-        char input[256];
+        char input[4096];
 
         if (fgets(input, sizeof(input), stdin) == NULL)
             break;
 
         input[strcspn(input, "\r\n")] = 0;
 
-        // add command
+        // add command, records are batched into blocks by the assembler
         if (strncmp(input, "ADD ", 4) == 0)
         {
-            char record_filename[256];
-            sscanf(input + 4, "%255s", record_filename);
+            char *save = NULL;
+            char *record_filename = strtok_r(input + 4, " \t", &save);
 
-            char filepath[512];
-            snprintf(filepath, sizeof(filepath),
-                     "offchain/records/%s", record_filename);
-
-            FILE *fp = fopen(filepath, "rb");
-            if (!fp)
+            while (record_filename)
             {
-                printf("[ERROR] File not found.\n");
-                continue;
+                queue_record_file(record_filename);
+                record_filename = strtok_r(NULL, " \t", &save);
             }
-
-            fseek(fp, 0, SEEK_END);
-            long filesize = ftell(fp);
-            rewind(fp);
-
-            char *file_buffer = malloc(filesize + 1);
-            fread(file_buffer, 1, filesize, fp);
-            file_buffer[filesize] = '\0';
-            fclose(fp);
-
-            char file_hash[HASH_SIZE];
-            sha256(file_buffer, file_hash);
-            free(file_buffer);
-
-            if (transaction_hash_exists(file_hash))
-            {
-                printf("[CONSENSUS] Duplicate record detected.\n");
-                continue;
-            }
-
-            Block last_block;
-            get_last_block(&last_block);
-
-            Block new_block;
-            memset(&new_block, 0, sizeof(Block));
-
-            init_block(&new_block,
-                       last_block.index + 1,
-                       last_block.block_hash);
-
-            new_block.transaction_count = 1;
-
-            strcpy(new_block.transactions[0].patient_id, "PATIENT_FROM_FILE");
-            strcpy(new_block.transactions[0].doctor_id, "DOCTOR_FROM_FILE");
-            strcpy(new_block.transactions[0].data_hash, file_hash);
-            strcpy(new_block.transactions[0].data_pointer, filepath);
-            new_block.transactions[0].timestamp = time(NULL);
-
-            calculate_block_hash(&new_block);
-
-            new_block.validator_port = own_port;
-
-            char private_key_path[64];
-            snprintf(private_key_path, sizeof(private_key_path),
-                     "keys/%d_private.pem", own_port);
-
-            if (!sign_data(new_block.block_hash,
-                           private_key_path,
-                           new_block.validator_signature))
-            {
-                printf("[CRYPTO] Signing failed.\n");
-                continue;
-            }
-
-            printf("[CONSENSUS] Proposing block %d\n", new_block.index);
-            propose_block(&new_block);
         }
 
         // height command
@@ -192,7 +211,10 @@ int main(int argc, char *argv[])
         else if (strcmp(input, "LAST") == 0)
         {
             if (get_last_block(&last_block))
+            {
                 print_block(&last_block);
+                free_block(&last_block);
+            }
         }
 
         // print block command
@@ -202,7 +224,10 @@ int main(int argc, char *argv[])
             Block block;
 
             if (get_block_by_index(index, &block))
+            {
                 print_block(&block);
+                free_block(&block);
+            }
             else
                 printf("[CHAIN] Block not found.\n");
         }
@@ -210,7 +235,7 @@ int main(int argc, char *argv[])
         // verify chain command
         else if (strcmp(input, "VERIFY") == 0)
         {
-            if (verify_blockchain())
+            if (verify_blockchain_full())
                 printf("[VERIFY] Blockchain integrity: VALID\n");
             else
                 printf("[VERIFY] Blockchain integrity: CORRUPTED\n");
@@ -239,27 +264,16 @@ int main(int argc, char *argv[])
             snprintf(filepath, sizeof(filepath),
                      "offchain/records/%s", filename);
 
-            FILE *fp = fopen(filepath, "rb");
-            if (!fp)
+            Digest hash;
+            if (!sha256_file(filepath, &hash))
             {
                 printf("[ERROR] File not found.\n");
                 continue;
             }
 
-            fseek(fp, 0, SEEK_END);
-            long size = ftell(fp);
-            rewind(fp);
-
-            char *buffer = malloc(size + 1);
-            fread(buffer, 1, size, fp);
-            buffer[size] = '\0';
-            fclose(fp);
-
-            char hash[HASH_SIZE];
-            sha256(buffer, hash);
-            free(buffer);
-
-            printf("[HASH] %s\n", hash);
+            char hex[DIGEST_HEX_SIZE];
+            digest_to_hex(&hash, hex);
+            printf("[HASH] %s\n", hex);
         }
 
         // check duplicate command
@@ -272,27 +286,14 @@ int main(int argc, char *argv[])
             snprintf(filepath, sizeof(filepath),
                      "offchain/records/%s", filename);
 
-            FILE *fp = fopen(filepath, "rb");
-            if (!fp)
+            Digest hash;
+            if (!sha256_file(filepath, &hash))
             {
                 printf("[ERROR] File not found.\n");
                 continue;
             }
 
-            fseek(fp, 0, SEEK_END);
-            long size = ftell(fp);
-            rewind(fp);
-
-            char *buffer = malloc(size + 1);
-            fread(buffer, 1, size, fp);
-            buffer[size] = '\0';
-            fclose(fp);
-
-            char hash[HASH_SIZE];
-            sha256(buffer, hash);
-            free(buffer);
-
-            if (transaction_hash_exists(hash))
+            if (transaction_hash_exists(&hash))
                 printf("[CHAIN] Record already exists.\n");
             else
                 printf("[CHAIN] Record not found in blockchain.\n");
@@ -314,12 +315,52 @@ int main(int argc, char *argv[])
             snprintf(public_key_path, sizeof(public_key_path),
                      "keys/%d_public.pem", block.validator_port);
 
-            if (verify_signature(block.block_hash,
+            char hash_hex[DIGEST_HEX_SIZE];
+            digest_to_hex(&block.block_hash, hash_hex);
+
+            if (verify_signature(hash_hex,
                                  public_key_path,
                                  block.validator_signature))
                 printf("[CRYPTO] Signature VALID.\n");
             else
                 printf("[CRYPTO] Signature INVALID.\n");
+
+            free_block(&block);
+        }
+
+        // quorum certificate command
+        else if (strncmp(input, "CHECKQC ", 8) == 0)
+        {
+            int index = atoi(input + 8);
+            Block block;
+
+            if (!get_block_by_index(index, &block))
+            {
+                printf("[CHAIN] Block not found.\n");
+                continue;
+            }
+
+            QuorumCertificate *qc = malloc(sizeof(QuorumCertificate));
+
+            if (!qc || !get_quorum_certificate(index, qc))
+                printf("[CONSENSUS] No quorum certificate stored for block %d.\n", index);
+            else if (quorum_verify(qc, &block))
+                printf("[CONSENSUS] Quorum certificate VALID (%d votes).\n", qc->vote_count);
+            else
+                printf("[CONSENSUS] Quorum certificate INVALID.\n");
+
+            free(qc);
+            free_block(&block);
+        }
+
+        // pipeline depth command
+        else if (strncmp(input, "PIPELINE", 8) == 0)
+        {
+            if (input[8] == ' ')
+                set_pipeline_depth(atoi(input + 9));
+
+            printf("[CONSENSUS] Pipeline depth: %d (%d in flight)\n",
+                   get_pipeline_depth(), proposals_in_flight());
         }
 
         // stats command
@@ -327,13 +368,33 @@ int main(int argc, char *argv[])
         {
             printf("[STATS] Height: %d\n", get_blockchain_height());
             printf("[STATS] Connected Peers: %d\n", get_peer_count());
+            printf("[STATS] Mempool: %d pending\n", mempool_size());
+
+            // per message type: queue wait and handler time in milliseconds
+            for (int type = 1; type < MSG_TYPE_COUNT; type++)
+            {
+                MessageStats stats;
+                protocol_get_stats(type, &stats);
+
+                if (stats.queued == 0)
+                    continue;
+
+                printf("[STATS] %-13s lane %d: %lu queued, %lu handled, "
+                       "wait avg %.2f max %.2f, run avg %.2f max %.2f\n",
+                       wire_type_name(type), protocol_lane(type),
+                       stats.queued, stats.handled,
+                       stats.handled ? stats.wait_total_ms / stats.handled : 0.0,
+                       stats.wait_max_ms,
+                       stats.handled ? stats.run_total_ms / stats.handled : 0.0,
+                       stats.run_max_ms);
+            }
         }
 
         // help command
         else if (strcmp(input, "HELP") == 0)
         {
             printf("Available Commands:\n");
-            printf("ADD <file>\n");
+            printf("ADD <file> [file...]\n");
             printf("HEIGHT\n");
             printf("LAST\n");
             printf("PRINT <index>\n");
@@ -343,6 +404,8 @@ int main(int argc, char *argv[])
             printf("HASH <file>\n");
             printf("CHECKDUP <file>\n");
             printf("CHECKSIG <index>\n");
+            printf("CHECKQC <index>\n");
+            printf("PIPELINE [depth]\n");
             printf("STATS\n");
             printf("HELP\n");
         }
@@ -353,5 +416,8 @@ int main(int argc, char *argv[])
         }
     }
 
+    stop_block_assembler();
+    signer_close(signer);
+
     return 0;
 }
@@ -1,35 +1,141 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
 
 #include "blockchain/block.h"
+#include "blockchain/chain_view.h"
 #include "crypto/hash.h"
+#include "crypto/signature.h"
+#include "network/serializer.h"
+#include "network/wire.h"
 
 #define BLOCKCHAIN_FILE "data/blockchain.dat"
 #define OFFCHAIN_DIR "offchain/records/"
 
 // hash file matching blockchain method
-int hash_file(const char *filename, char *output_hash) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
+int hash_file(const char *filename, Digest *output_hash) {
+    // same content hash the node stores for ADD
+    if (!sha256_file(filename, output_hash)) {
         printf("ERROR: Cannot open file %s\n", filename);
         return 0;
     }
 
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    fclose(fp);
+    return 1;
+}
+
+// check a record against a signed v3 header and its merkle path only
+int validate_against_header(const Digest *computed_hash, const Block *header,
+                            const Transaction *tx, const MerkleProof *proof) {
+    char hex[DIGEST_HEX_SIZE];
+    char public_key_path[64];
+    Digest header_hash;
+    Digest leaf;
+
+    if (header->version < BLOCK_VERSION_MERKLE) {
+        printf("ERROR: Block %d has no merkle root.\n", header->index);
+        return 0;
+    }
+
+    // the header must hash to its block hash and carry the validator's signature
+    compute_block_hash(header, &header_hash);
+    if (!digest_equal(&header_hash, &header->block_hash)) {
+        printf("STATUS: Block header %d does not match its hash!\n", header->index);
+        return 0;
+    }
+
+    snprintf(public_key_path, sizeof(public_key_path),
+             "keys/%d_public.pem", header->validator_port);
+
+    digest_to_hex(&header->block_hash, hex);
+    if (!verify_signature(hex, public_key_path, header->validator_signature)) {
+        printf("STATUS: Block header %d signature is INVALID!\n", header->index);
+        return 0;
+    }
+
+    transaction_leaf_hash(tx, &leaf);
+    if (!merkle_verify(&leaf, proof, &header->merkle_root)) {
+        printf("STATUS: Record is NOT included in block %d!\n", header->index);
+        return 0;
+    }
+
+    printf("Anchored in   : block %d (transaction %d of %d, %d proof hashes)\n",
+           header->index, proof->leaf_index + 1, proof->leaf_count, proof->depth);
+
+    if (digest_equal(&tx->data_hash, computed_hash)) {
+        printf("STATUS: Record is NOT altered.\n");
+    } else {
+        printf("STATUS: Record HAS BEEN altered!\n");
+    }
+
+    return 1;
+}
 
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), "%s:%ld", filename, size);
-    sha256(buffer, output_hash);
+// ask a node for the inclusion proof of a record hash
+int fetch_proof(int port, const Digest *data_hash, Block *header,
+                Transaction *tx, MerkleProof *proof) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return 0;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        printf("ERROR: Cannot connect to node on port %d\n", port);
+        close(sock);
+        return 0;
+    }
+
+    // introduce ourselves as a client, then ask for the proof
+    char hex[DIGEST_HEX_SIZE];
+    digest_to_hex(data_hash, hex);
+
+    size_t hello_len;
+    char *hello = wire_hello_frame(0, &hello_len);
+    int sent = hello && send(sock, hello, hello_len, MSG_NOSIGNAL) == (ssize_t)hello_len &&
+               wire_write_frame(sock, MSG_GET_PROOF, hex, strlen(hex) + 1);
+    free(hello);
+
+    // the node greets us too; skip anything that is not the proof
+    char *reply = NULL;
+    int type = 0;
+    size_t len;
+
+    while (sent && (reply = wire_read_frame(sock, &type, &len, SERIALIZED_PROOF_SIZE)) != NULL &&
+           type != MSG_PROOF) {
+        free(reply);
+        reply = NULL;
+    }
+
+    close(sock);
+
+    if (!reply || strcmp(reply, "NONE") == 0) {
+        printf("ERROR: No merkle block anchors this content (altered or never added).\n");
+        free(reply);
+        return 0;
+    }
+
+    int ok = deserialize_proof(reply, header, tx, proof);
+    free(reply);
+
+    if (!ok) {
+        printf("ERROR: Malformed proof from node.\n");
+        return 0;
+    }
 
     return 1;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     char record_name[128];
     char record_path[256];
-    char computed_hash[65];
+    Digest computed_hash;
 
     printf("Enter encrypted record file name to validate: ");
     scanf("%127s", record_name);
@@ -37,12 +143,25 @@ int main() {
     snprintf(record_path, sizeof(record_path),
              "%s%s", OFFCHAIN_DIR, record_name);
 
-    if (!hash_file(record_path, computed_hash)) {
+    if (!hash_file(record_path, &computed_hash)) {
         return 1;
     }
 
-    FILE *fp = fopen(BLOCKCHAIN_FILE, "rb");
-    if (!fp) {
+    // with a node port, only the block header and a proof are downloaded
+    if (argc > 1) {
+        Block header;
+        Transaction tx;
+        MerkleProof proof;
+
+        if (!fetch_proof(atoi(argv[1]), &computed_hash, &header, &tx, &proof))
+            return 1;
+
+        printf("\n--- RECORD VALIDATION RESULT ---\n");
+        return validate_against_header(&computed_hash, &header, &tx, &proof) ? 0 : 1;
+    }
+
+    ChainView view;
+    if (!chain_view_open(&view, BLOCKCHAIN_FILE)) {
         printf("ERROR: Blockchain file not found.\n");
         return 1;
     }
@@ -50,28 +169,42 @@ int main() {
     Block block;
     int found = 0;
 
-    while (fread(&block, sizeof(Block), 1, fp) == 1) {
+    for (int pos = 0; chain_view_block(&view, pos, &block); pos++) {
         for (int i = 0; i < block.transaction_count; i++) {
             if (strcmp(block.transactions[i].data_pointer, record_path) == 0) {
                 found = 1;
 
-                printf("\n--- RECORD VALIDATION RESULT ---\n");
-                printf("Stored Hash   : %s\n", block.transactions[i].data_hash);
-                printf("Computed Hash : %s\n", computed_hash);
+                char stored_hex[DIGEST_HEX_SIZE];
+                char computed_hex[DIGEST_HEX_SIZE];
+                digest_to_hex(&block.transactions[i].data_hash, stored_hex);
+                digest_to_hex(&computed_hash, computed_hex);
 
-                if (strcmp(block.transactions[i].data_hash, computed_hash) == 0) {
+                printf("\n--- RECORD VALIDATION RESULT ---\n");
+                printf("Stored Hash   : %s\n", stored_hex);
+                printf("Computed Hash : %s\n", computed_hex);
+
+                // merkle blocks are checked the same way a remote proof is
+                MerkleProof proof;
+                if (block.version >= BLOCK_VERSION_MERKLE &&
+                    block_merkle_proof(&block, i, &proof)) {
+                    validate_against_header(&computed_hash, &block,
+                                            &block.transactions[i], &proof);
+                } else if (digest_equal(&block.transactions[i].data_hash, &computed_hash)) {
                     printf("STATUS: Record is NOT altered.\n");
                 } else {
                     printf("STATUS: Record HAS BEEN altered!\n");
                 }
 
-                fclose(fp);
+                free_block(&block);
+                chain_view_close(&view);
                 return 0;
             }
         }
+
+        free_block(&block);
     }
 
-    fclose(fp);
+    chain_view_close(&view);
 
     if (!found) {
         printf("ERROR: Record not found in blockchain.\n");
@@ -2,22 +2,27 @@
 #include <string.h>
 #include <time.h>
 #include "blockchain/block.h"
+#include "blockchain/chain_view.h"
 
 int main() {
-    FILE *fp = fopen("data/blockchain_8001.dat", "rb");
-    if (!fp) {
+    ChainView view;
+    if (!chain_view_open(&view, "data/blockchain_8001.dat")) {
         printf("Blockchain file not found.\n");
         return 1;
     }
 
     Block block;
+    char hex[DIGEST_HEX_SIZE];
     printf("\n----- BLOCKCHAIN CONTENT -----\n");
 
-    while (fread(&block, sizeof(Block), 1, fp)) {
+    for (int pos = 0; chain_view_block(&view, pos, &block); pos++) {
         printf("\nBlock Index: %d\n", block.index);
+        printf("Version: %d\n", block.version);
         printf("Timestamp: %ld\n", block.timestamp);
-        printf("Previous Hash: %s\n", block.previous_hash);
-        printf("Block Hash: %s\n", block.block_hash);
+        digest_to_hex(&block.previous_hash, hex);
+        printf("Previous Hash: %s\n", hex);
+        digest_to_hex(&block.block_hash, hex);
+        printf("Block Hash: %s\n", hex);
         printf("Validator Signature: %s\n", block.validator_signature);
         printf("Transaction Count: %d\n", block.transaction_count);
 
@@ -25,11 +30,14 @@ int main() {
             printf("  Transaction %d:\n", i + 1);
             printf("    Patient ID: %s\n", block.transactions[i].patient_id);
             printf("    Doctor ID: %s\n", block.transactions[i].doctor_id);
-            printf("    Data Hash: %s\n", block.transactions[i].data_hash);
+            digest_to_hex(&block.transactions[i].data_hash, hex);
+            printf("    Data Hash: %s\n", hex);
             printf("    Data Pointer: %s\n", block.transactions[i].data_pointer);
         }
+
+        free_block(&block);
     }
 
-    fclose(fp);
+    chain_view_close(&view);
     return 0;
 }
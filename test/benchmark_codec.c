@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../src/network/serializer.h"
+#include "../src/blockchain/storage.h"
+#include "../src/crypto/hash.h"
+
+// encoded bytes processed per measurement
+#define BYTES_PER_RUN (64UL * 1024 * 1024)
+
+// threads decoding the same payload at once
+#define DECODE_THREADS 4
+
+typedef struct {
+    const char *payload;
+    size_t len;
+    size_t rounds;
+    int failures;
+} DecodeJob;
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// a committed-looking block with tx_count records
+static int build_block(Block *block, int tx_count)
+{
+    Digest previous;
+    sha256_digest("previous", 8, previous.bytes);
+
+    init_block(block, 1000, &previous);
+    block->version = BLOCK_VERSION_CURRENT;
+    block->validator_port = 8001;
+
+    for (int i = 0; i < tx_count; i++)
+    {
+        Transaction tx;
+        memset(&tx, 0, sizeof(tx));
+
+        snprintf(tx.patient_id, sizeof(tx.patient_id), "patient-%d", i);
+        snprintf(tx.doctor_id, sizeof(tx.doctor_id), "doctor-%d", i % 17);
+        sha256_digest(&i, sizeof(i), tx.data_hash.bytes);
+        snprintf(tx.data_pointer, sizeof(tx.data_pointer), "offchain/records/record%d.enc", i);
+        tx.timestamp = 1700000000 + i;
+
+        if (!add_transaction(block, &tx))
+            return 0;
+    }
+
+    block_merkle_root(block, &block->merkle_root);
+    calculate_block_hash(block);
+
+    // an RSA-2048 signature in hex
+    for (int i = 0; i < 512; i++)
+        block->validator_signature[i] = "0123456789abcdef"[(i * 7) % 16];
+
+    return 1;
+}
+
+// decode the shared payload repeatedly; every thread parses it in place
+static void *decode_runner(void *arg)
+{
+    DecodeJob *job = arg;
+
+    for (size_t i = 0; i < job->rounds; i++)
+    {
+        Block block;
+
+        if (!deserialize_block(job->payload, job->len, &block))
+        {
+            job->failures++;
+            continue;
+        }
+
+        free_block(&block);
+    }
+
+    return NULL;
+}
+
+// main benchmark loop
+int main(int argc, char *argv[])
+{
+    int counts[] = { 1, 16, 256, 1024, MAX_TRANSACTIONS };
+    int count_total = sizeof(counts) / sizeof(counts[0]);
+
+    if (argc > 1)
+    {
+        counts[0] = atoi(argv[1]);
+        count_total = 1;
+
+        if (counts[0] < 0 || counts[0] > MAX_TRANSACTIONS)
+        {
+            printf("Usage: %s [records_per_block]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("\n========== BLOCK CODEC BENCHMARK ==========\n");
+    printf("Decode threads: %d\n", DECODE_THREADS);
+    printf("===========================================\n");
+
+    int mismatches = 0;
+
+    for (int c = 0; c < count_total; c++)
+    {
+        Block block;
+
+        if (!build_block(&block, counts[c]))
+            return 1;
+
+        size_t capacity = block_record_bound(&block);
+        unsigned char *buffer = malloc(capacity);
+        unsigned char *check = malloc(capacity);
+
+        if (!buffer || !check)
+            return 1;
+
+        size_t len = encode_block_record(&block, buffer, capacity);
+        size_t rounds = BYTES_PER_RUN / (len ? len : 1) + 1;
+
+        struct timespec start, end;
+
+        // encode into the same caller buffer every round
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (size_t i = 0; i < rounds; i++)
+            len = encode_block_record(&block, buffer, capacity);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double encode_seconds = elapsed_seconds(&start, &end);
+
+        // single-threaded decode
+        DecodeJob single = { (const char *)buffer, len, rounds, 0 };
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        decode_runner(&single);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double decode_seconds = elapsed_seconds(&start, &end);
+
+        // concurrent decode of the same bytes
+        pthread_t threads[DECODE_THREADS];
+        DecodeJob jobs[DECODE_THREADS];
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int t = 0; t < DECODE_THREADS; t++)
+        {
+            jobs[t].payload = (const char *)buffer;
+            jobs[t].len = len;
+            jobs[t].rounds = rounds;
+            jobs[t].failures = 0;
+            pthread_create(&threads[t], NULL, decode_runner, &jobs[t]);
+        }
+
+        int failures = single.failures;
+
+        for (int t = 0; t < DECODE_THREADS; t++)
+        {
+            pthread_join(threads[t], NULL);
+            failures += jobs[t].failures;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double parallel_seconds = elapsed_seconds(&start, &end);
+
+        // the decoded block must encode to the same bytes
+        Block decoded;
+
+        if (failures ||
+            !deserialize_block((const char *)buffer, len, &decoded))
+        {
+            mismatches++;
+        }
+        else
+        {
+            if (encode_block_record(&decoded, check, capacity) != len ||
+                memcmp(buffer, check, len) != 0)
+                mismatches++;
+
+            free_block(&decoded);
+        }
+
+        double megabytes = (double)rounds * len / 1e6;
+
+        printf("%5d records, %8zu bytes: encode %7.1f MB/s (%8.2f us), "
+               "decode %7.1f MB/s (%8.2f us), %d threads %7.1f MB/s\n",
+               counts[c], len,
+               megabytes / encode_seconds, encode_seconds / rounds * 1e6,
+               megabytes / decode_seconds, decode_seconds / rounds * 1e6,
+               DECODE_THREADS, megabytes * DECODE_THREADS / parallel_seconds);
+
+        free(buffer);
+        free(check);
+        free_block(&block);
+    }
+
+    printf("===========================================\n");
+    printf("Round Trip Check: %s\n", mismatches ? "MISMATCH" : "OK");
+
+    return mismatches != 0;
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/crypto/hash.h"
+
+// total bytes hashed per measurement
+#define BYTES_PER_RUN (256UL * 1024 * 1024)
+
+// messages per multi-buffer call
+#define MANY_BATCH 256
+
+// message size for the multi-buffer run, close to a block header preimage
+#define MANY_MESSAGE_SIZE 300
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// hash a buffer repeatedly and return throughput in GB/s
+static double measure(const unsigned char *buffer, size_t size,
+                      unsigned char digest[DIGEST_SIZE])
+{
+    size_t rounds = BYTES_PER_RUN / size;
+    if (rounds == 0)
+        rounds = 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < rounds; i++)
+        sha256_digest(buffer, size, digest);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)rounds * size / elapsed_seconds(&start, &end) / 1e9;
+}
+
+// hash batches of small independent messages, as block verification does
+static double measure_many(const unsigned char *buffer, size_t size,
+                           unsigned char (*digests)[DIGEST_SIZE])
+{
+    const void *data[MANY_BATCH];
+    size_t lens[MANY_BATCH];
+
+    for (int i = 0; i < MANY_BATCH; i++)
+    {
+        data[i] = buffer + (size_t)i * size;
+        lens[i] = size;
+    }
+
+    size_t rounds = BYTES_PER_RUN / (size * MANY_BATCH);
+    if (rounds == 0)
+        rounds = 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t r = 0; r < rounds; r++)
+        sha256_digest_many(data, lens, MANY_BATCH, digests);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)rounds * size * MANY_BATCH / elapsed_seconds(&start, &end) / 1e9;
+}
+
+// main benchmark loop
+int main(int argc, char *argv[])
+{
+    size_t sizes[] = { 64, 1024, 16 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+    int size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+    if (argc > 1)
+    {
+        sizes[0] = strtoul(argv[1], NULL, 10);
+        size_count = 1;
+
+        if (sizes[0] == 0)
+        {
+            printf("Usage: %s [record_bytes]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size_t largest = 0;
+    for (int i = 0; i < size_count; i++)
+        if (sizes[i] > largest)
+            largest = sizes[i];
+
+    unsigned char *buffer = malloc(largest);
+    if (!buffer)
+        return 1;
+
+    srand(1);
+    for (size_t i = 0; i < largest; i++)
+        buffer[i] = rand() & 0xff;
+
+    int accelerated = sha256_set_accelerated(1);
+
+    printf("\n========== HASH BENCHMARK ==========\n");
+    printf("Backend: %s\n", sha256_backend_name());
+    printf("====================================\n");
+
+    int mismatches = 0;
+
+    for (int i = 0; i < size_count; i++)
+    {
+        unsigned char fast[DIGEST_SIZE], portable[DIGEST_SIZE];
+
+        sha256_set_accelerated(1);
+        double fast_rate = measure(buffer, sizes[i], fast);
+
+        sha256_set_accelerated(0);
+        double portable_rate = measure(buffer, sizes[i], portable);
+
+        if (memcmp(fast, portable, DIGEST_SIZE) != 0)
+            mismatches++;
+
+        if (accelerated)
+            printf("%10zu bytes: %7.3f GB/s (portable %.3f GB/s, %.1fx)\n",
+                   sizes[i], fast_rate, portable_rate, fast_rate / portable_rate);
+        else
+            printf("%10zu bytes: %7.3f GB/s\n", sizes[i], portable_rate);
+    }
+
+    // multi-buffer: many block-sized messages per call
+    unsigned char *messages = malloc((size_t)MANY_BATCH * MANY_MESSAGE_SIZE);
+    unsigned char (*many)[DIGEST_SIZE] = malloc(sizeof(*many) * MANY_BATCH);
+
+    if (messages && many)
+    {
+        for (size_t i = 0; i < (size_t)MANY_BATCH * MANY_MESSAGE_SIZE; i++)
+            messages[i] = rand() & 0xff;
+
+        sha256_set_accelerated(1);
+        double many_rate = measure_many(messages, MANY_MESSAGE_SIZE, many);
+
+        for (int i = 0; i < MANY_BATCH; i++)
+        {
+            unsigned char single[DIGEST_SIZE];
+            sha256_digest(messages + (size_t)i * MANY_MESSAGE_SIZE,
+                          MANY_MESSAGE_SIZE, single);
+
+            if (memcmp(single, many[i], DIGEST_SIZE) != 0)
+                mismatches++;
+        }
+
+        printf("------------------------------------\n");
+        printf("Multi-buffer (%s, %d lanes)\n",
+               sha256_lanes_name(), sha256_lane_count());
+        printf("%4d x %d bytes: %7.3f GB/s\n",
+               MANY_BATCH, MANY_MESSAGE_SIZE, many_rate);
+    }
+
+    free(messages);
+    free(many);
+
+    printf("====================================\n");
+    printf("Digest Check: %s\n", mismatches ? "MISMATCH" : "OK");
+
+    free(buffer);
+
+    return mismatches != 0;
+}
@@ -28,16 +28,32 @@ int main(int argc, char *argv[])
 {
     if (argc < 3)
     {
-        printf("Usage: %s <own_port> <block_count> [peer_ports...]\n", argv[0]);
+        printf("Usage: %s <own_port> <block_count> [-t txs_per_block] [peer_ports...]\n",
+               argv[0]);
         return 1;
     }
 
     int own_port = atoi(argv[1]);
     int block_count = atoi(argv[2]);
+    int txs_per_block = 1;
+    int first_peer = 3;
+
+    if (argc > 4 && strcmp(argv[3], "-t") == 0)
+    {
+        txs_per_block = atoi(argv[4]);
+        first_peer = 5;
+    }
+
+    if (txs_per_block < 1 || txs_per_block > MAX_TRANSACTIONS)
+    {
+        printf("Transactions per block must be 1..%d\n", MAX_TRANSACTIONS);
+        return 1;
+    }
 
     printf("\n========== BENCHMARK MODE ==========\n");
     printf("Node Port: %d\n", own_port);
     printf("Blocks to Commit: %d\n", block_count);
+    printf("Records per Block: %d\n", txs_per_block);
     printf("====================================\n");
 
     // set blockchain file path
@@ -56,8 +72,27 @@ int main(int argc, char *argv[])
         genesis.validator_port = own_port;
         create_genesis_block(&genesis, own_port);
         add_block(&genesis);
+        free_block(&genesis);
+    }
+    else
+    {
+        free_block(&last_block);
     }
 
+    // load the signing key once for the whole run; it also signs votes
+    char private_key_path[64];
+    snprintf(private_key_path, sizeof(private_key_path),
+             "keys/%d_private.pem", own_port);
+
+    Signer *signer = signer_open(private_key_path);
+    if (!signer)
+    {
+        printf("Signer initialization failed.\n");
+        return 1;
+    }
+
+    set_validator_identity(signer, own_port);
+
     // launch network server
     pthread_t server_thread;
     pthread_create(&server_thread, NULL, server_runner, &own_port);
@@ -65,7 +100,7 @@ int main(int argc, char *argv[])
     sleep(1);
 
     // connect to known peers
-    for (int i = 3; i < argc; i++)
+    for (int i = first_peer; i < argc; i++)
     {
         int peer_port = atoi(argv[i]);
         if (peer_port != own_port)
@@ -83,6 +118,9 @@ int main(int argc, char *argv[])
     clock_gettime(CLOCK_MONOTONIC, &start);
 
     double total_commit_time = 0.0;
+    double total_sign_time = 0.0;
+    int signed_count = 0;
+    int committed_count = 0;
 
     for (int i = 0; i < block_count; i++)
     {
@@ -96,57 +134,98 @@ int main(int argc, char *argv[])
 
         init_block(&new_block,
                    expected_index,
-                   last_block.block_hash);
+                   &last_block.block_hash);
+
+        free_block(&last_block);
 
-        new_block.transaction_count = 1;
+        if (!reserve_transactions(&new_block, txs_per_block))
+        {
+            printf("Out of memory.\n");
+            break;
+        }
 
-        char dummy_data[128];
-        snprintf(dummy_data, sizeof(dummy_data),
-                 "BENCH_DATA_%d_%ld", i, time(NULL));
+        for (int t = 0; t < txs_per_block; t++)
+        {
+            char dummy_data[128];
+            snprintf(dummy_data, sizeof(dummy_data),
+                     "BENCH_DATA_%d_%d_%ld", i, t, time(NULL));
 
-        char hash[HASH_SIZE];
-        sha256(dummy_data, hash);
+            Transaction tx;
+            memset(&tx, 0, sizeof(Transaction));
 
-        strcpy(new_block.transactions[0].patient_id, "BENCH_PATIENT");
-        strcpy(new_block.transactions[0].doctor_id, "BENCH_DOCTOR");
-        strcpy(new_block.transactions[0].data_hash, hash);
-        strcpy(new_block.transactions[0].data_pointer, "BENCH_DATA");
+            sha256_digest(dummy_data, strlen(dummy_data), tx.data_hash.bytes);
 
-        new_block.transactions[0].timestamp = time(NULL);
+            strcpy(tx.patient_id, "BENCH_PATIENT");
+            strcpy(tx.doctor_id, "BENCH_DOCTOR");
+            strcpy(tx.data_pointer, "BENCH_DATA");
+            tx.timestamp = time(NULL);
+
+            add_transaction(&new_block, &tx);
+        }
 
         calculate_block_hash(&new_block);
 
         new_block.validator_port = own_port;
 
-        char private_key_path[64];
-        snprintf(private_key_path, sizeof(private_key_path),
-                 "keys/%d_private.pem", own_port);
+        struct timespec sign_start, sign_end;
+        clock_gettime(CLOCK_MONOTONIC, &sign_start);
 
-        if (!sign_data(new_block.block_hash,
-                       private_key_path,
-                       new_block.validator_signature))
+        char hash_hex[DIGEST_HEX_SIZE];
+        digest_to_hex(&new_block.block_hash, hash_hex);
+
+        if (!signer_sign(signer,
+                         hash_hex,
+                         new_block.validator_signature))
         {
             printf("Signing failed.\n");
+            free_block(&new_block);
             continue;
         }
 
+        clock_gettime(CLOCK_MONOTONIC, &sign_end);
+
+        total_sign_time +=
+            (sign_end.tv_sec - sign_start.tv_sec) +
+            (sign_end.tv_nsec - sign_start.tv_nsec) / 1e9;
+        signed_count++;
+
         struct timespec block_start, block_end;
         clock_gettime(CLOCK_MONOTONIC, &block_start);
 
-        propose_block(&new_block);
+        int proposed = propose_block(&new_block);
+        free_block(&new_block);
+
+        if (!proposed)
+        {
+            printf("Block %d was not proposed.\n", expected_index);
+            continue;
+        }
+
+        // wait for block finalization, no longer than a proposal lives
+        int committed = 0;
 
-        // wait for block finalization
         while (1)
         {
-            Block check_block;
-            if (get_last_block(&check_block))
+            if (get_blockchain_height() > expected_index)
             {
-                if (check_block.index >= expected_index)
-                    break;
+                committed = 1;
+                break;
             }
+
+            clock_gettime(CLOCK_MONOTONIC, &block_end);
+
+            if (block_end.tv_sec - block_start.tv_sec >= PROPOSAL_TIMEOUT_SEC)
+                break;
+
             usleep(1000);
         }
 
+        if (!committed)
+        {
+            printf("Block %d was not committed in time.\n", expected_index);
+            continue;
+        }
+
         clock_gettime(CLOCK_MONOTONIC, &block_end);
 
         double commit_time =
@@ -154,6 +233,7 @@ int main(int argc, char *argv[])
             (block_end.tv_nsec - block_start.tv_nsec) / 1e9;
 
         total_commit_time += commit_time;
+        committed_count++;
     }
 
     clock_gettime(CLOCK_MONOTONIC, &end);
@@ -163,13 +243,28 @@ int main(int argc, char *argv[])
         (end.tv_nsec - start.tv_nsec) / 1e9;
 
     printf("\n========== BENCHMARK RESULTS ==========\n");
-    printf("Blocks Successfully Committed: %d\n", block_count);
+    printf("Blocks Successfully Committed: %d of %d\n", committed_count, block_count);
     printf("Total Benchmark Time: %.4f seconds\n", total_time);
-    printf("Average Commit Latency: %.6f seconds\n",
-           total_commit_time / block_count);
+
+    if (committed_count > 0)
+        printf("Average Commit Latency: %.6f seconds\n",
+               total_commit_time / committed_count);
+
     printf("True Consensus Throughput: %.2f blocks/sec\n",
-           block_count / total_time);
+           committed_count / total_time);
+    printf("Record Throughput: %.2f records/sec\n",
+           (double)committed_count * txs_per_block / total_time);
+
+    if (signed_count > 0 && total_sign_time > 0.0)
+    {
+        printf("Average Signing Time: %.6f seconds\n",
+               total_sign_time / signed_count);
+        printf("Signing Throughput: %.2f signatures/sec\n",
+               signed_count / total_sign_time);
+    }
     printf("=======================================\n");
 
+    signer_close(signer);
+
     return 0;
 }
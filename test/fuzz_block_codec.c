@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/network/serializer.h"
+#include "../src/blockchain/storage.h"
+#include "../src/crypto/hash.h"
+
+// default mutated inputs per run
+#define FUZZ_ITERATIONS 200000
+
+// largest input the mutator produces
+#define FUZZ_INPUT_MAX (64 * 1024)
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+} Seed;
+
+static unsigned long rng_state = 1;
+
+static unsigned long next_random()
+{
+    // xorshift, so runs repeat for a given seed
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void build_block(Block *block, int version, int tx_count, int genesis)
+{
+    Digest previous;
+    memset(&previous, 0, sizeof(previous));
+
+    if (!genesis)
+        sha256_digest("previous", 8, previous.bytes);
+
+    init_block(block, genesis ? 0 : 42, &previous);
+    block->version = version;
+    block->validator_port = 8001;
+
+    for (int i = 0; i < tx_count; i++)
+    {
+        Transaction tx;
+        memset(&tx, 0, sizeof(tx));
+
+        snprintf(tx.patient_id, sizeof(tx.patient_id), "p%d", i);
+        snprintf(tx.doctor_id, sizeof(tx.doctor_id), "d%d", i);
+        sha256_digest(&i, sizeof(i), tx.data_hash.bytes);
+        snprintf(tx.data_pointer, sizeof(tx.data_pointer), "offchain/records/r%d.enc", i);
+        tx.timestamp = 1700000000 + i;
+
+        add_transaction(block, &tx);
+    }
+
+    if (version >= BLOCK_VERSION_MERKLE)
+        block_merkle_root(block, &block->merkle_root);
+
+    calculate_block_hash(block);
+
+    // alternate hex and free-text signatures to reach both field kinds
+    if (tx_count % 2)
+        snprintf(block->validator_signature, HASH_SIZE, "%s", "abcdef0123456789");
+    else
+        snprintf(block->validator_signature, HASH_SIZE, "%s", "not|hex~text");
+}
+
+// block payloads, and commit payloads with a certificate in front
+static int build_seeds(Seed *seeds, int max)
+{
+    int versions[] = { BLOCK_VERSION_LEGACY, BLOCK_VERSION_BINARY, BLOCK_VERSION_MERKLE };
+    int counts[] = { 0, 1, 3, 40 };
+    int total = 0;
+
+    for (int v = 0; v < 3; v++)
+    {
+        for (int c = 0; c < 4 && total + 2 <= max; c++)
+        {
+            Block block;
+            build_block(&block, versions[v], counts[c], c == 0);
+
+            size_t len = 0;
+            char *frame = serialize_block_frame(MSG_PROPOSE_BLOCK, &block, &len);
+
+            if (frame)
+            {
+                seeds[total].len = len - WIRE_HEADER_SIZE;
+                seeds[total].data = malloc(seeds[total].len);
+                memcpy(seeds[total].data, frame + WIRE_HEADER_SIZE, seeds[total].len);
+                total++;
+                free(frame);
+            }
+
+            QuorumCertificate qc;
+            quorum_init(&qc, block.index, &block.block_hash);
+            quorum_add_vote(&qc, 8001, "00ff00ff");
+            quorum_add_vote(&qc, 8002, "text signature");
+
+            frame = serialize_commit_frame(&block, &qc, &len);
+
+            if (frame)
+            {
+                seeds[total].len = len - WIRE_HEADER_SIZE;
+                seeds[total].data = malloc(seeds[total].len);
+                memcpy(seeds[total].data, frame + WIRE_HEADER_SIZE, seeds[total].len);
+                total++;
+                free(frame);
+            }
+
+            free_block(&block);
+        }
+    }
+
+    return total;
+}
+
+// flip, overwrite, insert, drop or truncate at random places
+static size_t mutate(unsigned char *data, size_t len)
+{
+    int edits = 1 + next_random() % 8;
+
+    for (int e = 0; e < edits; e++)
+    {
+        size_t at = len ? next_random() % len : 0;
+
+        switch (next_random() % 6)
+        {
+        case 0:
+            if (len)
+                data[at] ^= 1 << (next_random() % 8);
+            break;
+        case 1:
+            if (len)
+                data[at] = next_random() & 0xff;
+            break;
+        case 2:
+            // interesting values hit the length and count fields
+            if (len)
+                data[at] = (next_random() % 2) ? 0xff : 0x00;
+            break;
+        case 3:
+            if (len < FUZZ_INPUT_MAX)
+            {
+                memmove(data + at + 1, data + at, len - at);
+                data[at] = next_random() & 0xff;
+                len++;
+            }
+            break;
+        case 4:
+            if (len)
+            {
+                memmove(data + at, data + at + 1, len - at - 1);
+                len--;
+            }
+            break;
+        default:
+            len = at;
+            break;
+        }
+    }
+
+    return len;
+}
+
+// whatever decodes must encode and decode again to the same bytes
+static int check_block(const Block *block, unsigned char *scratch, unsigned char *again)
+{
+    if (block->transaction_count < 0 || block->transaction_count > MAX_TRANSACTIONS)
+        return 0;
+
+    size_t capacity = BLOCK_RECORD_FIXED + (size_t)MAX_TRANSACTIONS * BLOCK_RECORD_TX_MAX;
+    size_t len = encode_block_record(block, scratch, capacity);
+
+    if (len == 0)
+        return 1;   // e.g. a decoded text signature too long to re-encode
+
+    Block copy;
+    if (!deserialize_block((const char *)scratch, len, &copy))
+        return 0;
+
+    size_t again_len = encode_block_record(&copy, again, capacity);
+    free_block(&copy);
+
+    return again_len == len && memcmp(scratch, again, len) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : FUZZ_ITERATIONS;
+    rng_state = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+    if (iterations <= 0 || rng_state == 0)
+    {
+        printf("Usage: %s [iterations] [nonzero_seed]\n", argv[0]);
+        return 1;
+    }
+
+    Seed seeds[32];
+    int seed_count = build_seeds(seeds, 32);
+
+    size_t capacity = BLOCK_RECORD_FIXED + (size_t)MAX_TRANSACTIONS * BLOCK_RECORD_TX_MAX;
+    unsigned char *input = malloc(FUZZ_INPUT_MAX + 1);
+    unsigned char *scratch = malloc(capacity);
+    unsigned char *again = malloc(capacity);
+
+    if (!input || !scratch || !again)
+        return 1;
+
+    // every seed must decode as built
+    int failures = 0;
+
+    for (int i = 0; i < seed_count; i++)
+    {
+        Block block;
+        QuorumCertificate qc;
+
+        if (!deserialize_block((const char *)seeds[i].data, seeds[i].len, &block) &&
+            !deserialize_commit((const char *)seeds[i].data, seeds[i].len, &qc, &block))
+        {
+            printf("[FUZZ] Seed %d does not decode.\n", i);
+            failures++;
+            continue;
+        }
+
+        free_block(&block);
+    }
+
+    long accepted = 0;
+
+    for (long n = 0; n < iterations && failures == 0; n++)
+    {
+        size_t len;
+
+        // mostly mutated seeds, sometimes plain noise
+        if (next_random() % 16 == 0)
+        {
+            len = next_random() % 512;
+            for (size_t i = 0; i < len; i++)
+                input[i] = next_random() & 0xff;
+        }
+        else
+        {
+            Seed *seed = &seeds[next_random() % seed_count];
+            memcpy(input, seed->data, seed->len);
+            len = mutate(input, seed->len);
+        }
+
+        // decoders get exactly len bytes, so reads past it show under ASan
+        unsigned char *exact = malloc(len ? len : 1);
+        memcpy(exact, input, len);
+
+        Block block;
+        QuorumCertificate qc;
+
+        if (deserialize_block((const char *)exact, len, &block))
+        {
+            accepted++;
+
+            if (!check_block(&block, scratch, again))
+            {
+                printf("[FUZZ] Block round trip differs at iteration %ld.\n", n);
+                failures++;
+            }
+
+            free_block(&block);
+        }
+
+        if (deserialize_commit((const char *)exact, len, &qc, &block))
+        {
+            accepted++;
+
+            if (qc.vote_count < 0 || qc.vote_count > MAX_VALIDATORS ||
+                !check_block(&block, scratch, again))
+            {
+                printf("[FUZZ] Commit round trip differs at iteration %ld.\n", n);
+                failures++;
+            }
+
+            free_block(&block);
+        }
+
+        free(exact);
+    }
+
+    printf("[FUZZ] %ld inputs, %ld decoded, %s\n", iterations, accepted,
+           failures ? "FAILED" : "OK");
+
+    for (int i = 0; i < seed_count; i++)
+        free(seeds[i].data);
+
+    free(input);
+    free(scratch);
+    free(again);
+
+    return failures != 0;
+}